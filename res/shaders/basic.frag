@@ -16,7 +16,15 @@ in VS_OUT {
 
 uniform sampler2D texture_diffuse;
 uniform vec3 lightPos;
-uniform vec3 viewPos;
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
 uniform bool blinn;
 uniform Material material;
 
@@ -31,7 +39,7 @@ void main()
     float diff = max(dot(lightDir, normal), 0.0);
     vec3 diffuse = diff * color;
     // specular
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDir = normalize(cameraPosition.xyz - fs_in.FragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = 0.0;
 
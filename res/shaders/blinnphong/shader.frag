@@ -7,161 +7,48 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
+#ifdef TINT
+// per instance color of prefab instances (src/PrefabInstancer.h)
+flat in vec4 Tint;
+#endif
+
 struct Material {
     sampler2D diffuse;
     sampler2D specular;
     float shininess;
 };
 
-struct DirLight {
-    bool isOn;
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float intensity;
-};
-
-struct PointLight {
-    bool isOn;
-    vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    float intensity;
-};
-
-struct SpotLight {
-    bool isOn;
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    float intensity;
-};
-#define NUM_POINT_LIGHTS 1
-#define NUM_SPOT_LIGHTS 2
-
-uniform DirLight dirLight;
-uniform PointLight pointLights[NUM_POINT_LIGHTS];
-uniform SpotLight spotLights[NUM_SPOT_LIGHTS];
 uniform Material material;
 
 //uniform sampler2D texture_diffuse;
 uniform vec3 lightPos;
-uniform vec3 viewPos;
-
-float BlinnPhongSpecular(vec3 lightDir, vec3 normal, vec3 viewDir, float shininess) {
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
-    return spec;
-}
 
-// calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-    if (light.isOn == false) return vec3(0);
-    vec3 lightDir = normalize(-light.direction);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-//    vec3 reflectDir = reflect(-lightDir, normal);
-//    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    float spec = BlinnPhongSpecular(lightDir, normal, viewDir, material.shininess);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, fs_in.TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fs_in.TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoords));
-    return (ambient * light.intensity + diffuse * light.intensity + specular * light.intensity);
-}
-
-// calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    if (light.isOn == false) return vec3(0);
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-//    vec3 reflectDir = reflect(-lightDir, normal);
-//    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    float spec = BlinnPhongSpecular(lightDir, normal, viewDir, material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, fs_in.TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fs_in.TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoords));
-    ambient *= attenuation * light.intensity;
-    diffuse *= attenuation * light.intensity;
-    specular *= attenuation * light.intensity;
-    return (ambient + diffuse + specular);
-}
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
 
-// calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    if (light.isOn == false) return vec3(0);
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-//    vec3 reflectDir = reflect(-lightDir, normal);
-//    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    float spec = BlinnPhongSpecular(lightDir, normal, viewDir, material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, fs_in.TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fs_in.TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoords));
-    ambient *= attenuation * light.intensity * intensity;
-    diffuse *= attenuation * light.intensity * intensity;
-    specular *= attenuation * light.intensity * intensity;
-    return (ambient + diffuse + specular);
-}
+#include "../lighting.glsl"
 
 void main()
 {
     vec3 norm = normalize(fs_in.Normal);
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDir = normalize(cameraPosition.xyz - fs_in.FragPos);
 
     // == =====================================================
-    // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
-    // For each phase, a calculate function is defined that calculates the corresponding color
-    // per lamp. In the main() function we take all the calculated colors and sum them up for
-    // this fragment's final color.
+    // Our lighting is set up in 2 phases: directional and the local lights of this fragment's cluster
+    // The calculate functions in lighting.glsl give the color per lamp and CalcLighting() sums them up
+    // for this fragment's final color.
     // == =====================================================
-    // phase 1: directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: point lights
-    for(int i = 0; i < NUM_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, fs_in.FragPos, viewDir);
-    // phase 3: spot light
-    for(int i = 0; i < NUM_SPOT_LIGHTS; i++)
-        result += CalcSpotLight(spotLights[i], norm, fs_in.FragPos, viewDir);
+    vec3 albedo = vec3(texture(material.diffuse, fs_in.TexCoords));
+    vec3 specularColor = vec3(texture(material.specular, fs_in.TexCoords));
+    vec3 result = CalcLighting(norm, fs_in.FragPos, viewDir, albedo, specularColor, material.shininess);
 
+#ifdef TINT
+    result *= Tint.rgb;
+#endif
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
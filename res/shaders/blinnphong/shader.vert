@@ -2,7 +2,17 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// the instance transform, in the layout InstanceManager streams for the format
+#if defined(INSTANCE_AFFINE)
+layout (location = 3) in vec4 aInstanceRow0;
+layout (location = 4) in vec4 aInstanceRow1;
+layout (location = 5) in vec4 aInstanceRow2;
+#elif defined(INSTANCE_QUATERNION)
+layout (location = 3) in vec4 aInstancePositionScale;
+layout (location = 4) in vec4 aInstanceRotation;
+#else
 layout (location = 3) in mat4 aInstanceMatrix;
+#endif
 
 out VS_OUT {
     vec3 FragPos;
@@ -10,13 +20,40 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
+mat4 instanceMatrix()
+{
+#if defined(INSTANCE_AFFINE)
+    return transpose(mat4(aInstanceRow0, aInstanceRow1, aInstanceRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+#elif defined(INSTANCE_QUATERNION)
+    vec4 q = normalize(aInstanceRotation);
+    vec3 q2 = 2.0 * q.xyz;
+    vec3 diagonal = q.xyz * q2;
+    vec3 products = q.xxy * q2.yzz;
+    vec3 w = q.w * q2;
+    float s = aInstancePositionScale.w;
+    return mat4(
+        vec4(1.0 - diagonal.y - diagonal.z, products.x + w.z, products.y - w.y, 0.0) * s,
+        vec4(products.x - w.z, 1.0 - diagonal.x - diagonal.z, products.z + w.x, 0.0) * s,
+        vec4(products.y + w.y, products.z - w.x, 1.0 - diagonal.x - diagonal.y, 0.0) * s,
+        vec4(aInstancePositionScale.xyz, 1.0));
+#else
+    return aInstanceMatrix;
+#endif
+}
 
 void main()
 {
-    vs_out.FragPos = vec3(aInstanceMatrix * vec4(aPos, 1.0));
-    vs_out.Normal = mat3(transpose(inverse(aInstanceMatrix))) * aNormal;
+    mat4 model = instanceMatrix();
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
     vs_out.TexCoords = aTexCoords;
-    gl_Position = projection * view * aInstanceMatrix * vec4(aPos, 1.0);
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
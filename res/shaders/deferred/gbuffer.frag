@@ -0,0 +1,36 @@
+#version 410 core
+layout (location = 0) out vec4 gPosition;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gAlbedoSpec;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} fs_in;
+
+#ifdef TINT
+// per instance color of prefab instances (src/PrefabInstancer.h)
+flat in vec4 Tint;
+#endif
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+uniform Material material;
+
+// geometry pass of the deferred path, lighting happens later in lighting.frag
+void main()
+{
+    gPosition = vec4(fs_in.FragPos, 1.0);
+    gNormal = vec4(normalize(fs_in.Normal), 1.0);
+    gAlbedoSpec.rgb = texture(material.diffuse, fs_in.TexCoords).rgb;
+#ifdef TINT
+    gAlbedoSpec.rgb *= Tint.rgb;
+#endif
+    // one channel of specular, coloured specular maps come out grey here while the forward path keeps their colour
+    gAlbedoSpec.a = texture(material.specular, fs_in.TexCoords).r;
+}
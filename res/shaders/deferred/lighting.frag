@@ -0,0 +1,35 @@
+#version 410 core
+out vec4 FragColor;
+
+// lighting pass of the deferred path, the same lights and clusters as blinnphong/shader.frag
+// applied once per pixel to what the geometry pass left in the G-buffer
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+uniform float shininess;
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
+#include "../lighting.glsl"
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 normalSample = texelFetch(gNormal, pixel, 0);
+    // nothing was drawn here, the sky fills it later
+    if (normalSample.w == 0.0) discard;
+
+    vec3 fragPos = texelFetch(gPosition, pixel, 0).xyz;
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec3 norm = normalSample.xyz;
+    vec3 viewDir = normalize(cameraPosition.xyz - fragPos);
+
+    vec3 result = CalcLighting(norm, fragPos, viewDir, albedoSpec.rgb, vec3(albedoSpec.a), shininess);
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 aInstanceMatrix;
+layout (location = 7) in vec4 aInstanceColor;
+
+flat out vec3 Color;
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
+void main()
+{
+    Color = aInstanceColor.rgb;
+    gl_Position = viewProjection * aInstanceMatrix * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+// Blinn-Phong lighting shared by the forward (blinnphong/shader.frag) and deferred (deferred/lighting.frag) paths.
+// Pulled in with #include by the Shader class, after the FrameUniforms block which clusterIndex() reads.
+
+// one light of any type, packed by the LightManager (src/LightManager.h)
+// point and spot lights are read from the lightData texture buffer, seven texels each
+struct Light {
+    vec4 position;      // xyz, w is 1 when the light is on
+    vec4 direction;     // w is 1 for spot lights
+    vec4 ambient;       // rgb, a is the intensity
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation;   // constant, linear, quadratic, range
+    vec4 cone;          // cosines of the inner and outer cut off
+};
+
+layout (std140) uniform LightUniforms {
+    ivec4 lightCounts;  // local lights
+    Light dirLight;
+};
+
+// froxel grid built by LightClusters (src/LightClusters.h)
+layout (std140) uniform ClusterUniforms {
+    uvec4 clusterGridSize;  // tiles in x and y, depth slices
+    vec4 clusterScale;      // tiles per pixel in x and y, slice = log(depth) * z + w
+};
+
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;     // offset, count per froxel
+uniform usamplerBuffer clusterLights;   // light ids
+
+float BlinnPhongSpecular(vec3 lightDir, vec3 normal, vec3 viewDir, float shininess) {
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    return spec;
+}
+
+Light fetchLight(int id)
+{
+    int texel = id * 7;
+    Light light;
+    light.position = texelFetch(lightData, texel);
+    light.direction = texelFetch(lightData, texel + 1);
+    light.ambient = texelFetch(lightData, texel + 2);
+    light.diffuse = texelFetch(lightData, texel + 3);
+    light.specular = texelFetch(lightData, texel + 4);
+    light.attenuation = texelFetch(lightData, texel + 5);
+    light.cone = texelFetch(lightData, texel + 6);
+    return light;
+}
+
+// the froxel this fragment falls into
+int clusterIndex(vec3 fragPos)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    uint slice = uint(clamp(log(max(depth, 1e-4)) * clusterScale.z + clusterScale.w, 0.0, float(clusterGridSize.z - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterScale.xy), clusterGridSize.xy - 1u);
+    return int((slice * clusterGridSize.y + tile.y) * clusterGridSize.x + tile.x);
+}
+
+// calculates the color when using a directional light.
+vec3 CalcDirLight(Light light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor, float shininess)
+{
+    if (light.position.w == 0.0) return vec3(0);
+    vec3 lightDir = normalize(-light.direction.xyz);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+//    vec3 reflectDir = reflect(-lightDir, normal);
+//    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float spec = BlinnPhongSpecular(lightDir, normal, viewDir, shininess);
+    // combine results
+    float lightIntensity = light.ambient.a;
+    vec3 ambient = light.ambient.rgb * albedo;
+    vec3 diffuse = light.diffuse.rgb * diff * albedo;
+    vec3 specular = light.specular.rgb * spec * specularColor;
+    return (ambient * lightIntensity + diffuse * lightIntensity + specular * lightIntensity);
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor, float shininess)
+{
+    if (light.position.w == 0.0) return vec3(0);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+//    vec3 reflectDir = reflect(-lightDir, normal);
+//    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float spec = BlinnPhongSpecular(lightDir, normal, viewDir, shininess);
+    // attenuation
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));
+    // combine results
+    float lightIntensity = light.ambient.a;
+    vec3 ambient = light.ambient.rgb * albedo;
+    vec3 diffuse = light.diffuse.rgb * diff * albedo;
+    vec3 specular = light.specular.rgb * spec * specularColor;
+    ambient *= attenuation * lightIntensity;
+    diffuse *= attenuation * lightIntensity;
+    specular *= attenuation * lightIntensity;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor, float shininess)
+{
+    if (light.position.w == 0.0) return vec3(0);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+//    vec3 reflectDir = reflect(-lightDir, normal);
+//    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float spec = BlinnPhongSpecular(lightDir, normal, viewDir, shininess);
+    // attenuation
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction.xyz));
+    float epsilon = light.cone.x - light.cone.y;
+    float intensity = clamp((theta - light.cone.y) / epsilon, 0.0, 1.0);
+    // combine results
+    float lightIntensity = light.ambient.a;
+    vec3 ambient = light.ambient.rgb * albedo;
+    vec3 diffuse = light.diffuse.rgb * diff * albedo;
+    vec3 specular = light.specular.rgb * spec * specularColor;
+    ambient *= attenuation * lightIntensity * intensity;
+    diffuse *= attenuation * lightIntensity * intensity;
+    specular *= attenuation * lightIntensity * intensity;
+    return (ambient + diffuse + specular);
+}
+
+// directional light plus the point and spot lights reaching into the fragment's cluster
+vec3 CalcLighting(vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor, float shininess)
+{
+    vec3 result = CalcDirLight(dirLight, normal, viewDir, albedo, specularColor, shininess);
+    uvec2 cluster = texelFetch(clusterGrid, clusterIndex(fragPos)).xy;
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        Light light = fetchLight(int(texelFetch(clusterLights, int(cluster.x + i)).r));
+        if (light.direction.w > 0.5)
+            result += CalcSpotLight(light, normal, fragPos, viewDir, albedo, specularColor, shininess);
+        else
+            result += CalcPointLight(light, normal, fragPos, viewDir, albedo, specularColor, shininess);
+    }
+    return result;
+}
@@ -0,0 +1,30 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 3) in mat4 aInstanceMatrix;
+layout (location = 7) in vec4 aInstanceTint;
+
+out vec3 Normal;
+out vec3 Position;
+
+flat out vec4 Tint;
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
+// where the drawn part sits in the prefab
+uniform mat4 part;
+
+void main()
+{
+    mat4 model = aInstanceMatrix * part;
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Position = vec3(model * vec4(aPos, 1.0));
+    Tint = aInstanceTint;
+    gl_Position = viewProjection * vec4(Position, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aInstanceMatrix;
+layout (location = 7) in vec4 aInstanceTint;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} vs_out;
+
+flat out vec4 Tint;
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
+// where the drawn part sits in the prefab
+uniform mat4 part;
+
+void main()
+{
+    mat4 model = aInstanceMatrix * part;
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
+    vs_out.TexCoords = aTexCoords;
+    Tint = aInstanceTint;
+    gl_Position = viewProjection * vec4(vs_out.FragPos, 1.0);
+}
\ No newline at end of file
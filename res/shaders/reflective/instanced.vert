@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 3) in mat4 aInstanceMatrix;
+
+out vec3 Normal;
+out vec3 Position;
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
+void main()
+{
+    Normal = mat3(transpose(inverse(aInstanceMatrix))) * aNormal;
+    Position = vec3(aInstanceMatrix * vec4(aPos, 1.0));
+    gl_Position = viewProjection * vec4(Position, 1.0);
+}
\ No newline at end of file
@@ -4,12 +4,28 @@ out vec4 FragColor;
 in vec3 Normal;
 in vec3 Position;
 
-uniform vec3 cameraPos;
+#ifdef TINT
+// per instance color of prefab instances (src/PrefabInstancer.h)
+flat in vec4 Tint;
+#endif
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
 uniform samplerCube skybox;
 
 void main()
 {
-    vec3 I = normalize(Position - cameraPos);
+    vec3 I = normalize(Position - cameraPosition.xyz);
     vec3 R = reflect(I, normalize(Normal));
-    FragColor = vec4(texture(skybox, R).rgb, 1.0);
+    vec3 color = texture(skybox, R).rgb;
+#ifdef TINT
+    color *= Tint.rgb;
+#endif
+    FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -4,7 +4,19 @@ out vec4 FragColor;
 in vec3 Normal;
 in vec3 Position;
 
-uniform vec3 cameraPos;
+#ifdef TINT
+// per instance color of prefab instances (src/PrefabInstancer.h)
+flat in vec4 Tint;
+#endif
+
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
 uniform samplerCube skybox;
 
 // IoRs for red, green, and blue channels
@@ -14,7 +26,7 @@ uniform sampler2D screenTexture;
 
 void main()
 {
-    vec3 I = normalize(Position - cameraPos);
+    vec3 I = normalize(Position - cameraPosition.xyz);
     vec3 N = normalize(Normal);
 
     vec3 R_red = refract(I + aberrationStrength * vec3(0.01, 0.0, 0.0), N, 1.0 / iorRGB.r);
@@ -26,6 +38,9 @@ void main()
     float b = texture(skybox, R_blue).b;
 
     vec3 color = vec3(r, g, b);
+#ifdef TINT
+    color *= Tint.rgb;
+#endif
 
     FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
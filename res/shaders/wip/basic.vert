@@ -9,9 +9,15 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform bool torus;
 
 void main()
@@ -23,6 +29,6 @@ void main()
     if (torus) {
         gl_Position = vec4(aPos, 1.0); // Pass raw position for torus
     } else {
-        gl_Position = projection * view * model * vec4(aPos, 1.0);
+        gl_Position = viewProjection * model * vec4(aPos, 1.0);
     }
 }
\ No newline at end of file
@@ -165,13 +165,13 @@ public:
 
                 float t = animationFrame.timeToLerp * delta;
 
-                node->transform.setLocalPosition(Util::lerp(node->transform.position, animationFrame.position, t));
-                node->transform.setEulerRotation(Util::lerp(node->transform.eulerRotation, animationFrame.rotation, t));
-                node->transform.setScale(Util::lerp(node->transform.scale, animationFrame.scale, t));
+                node->transform.setLocalPosition(Util::lerp(node->transform.getLocalPosition(), animationFrame.position, t));
+                node->transform.setEulerRotation(Util::lerp(node->transform.getEulerRotation(), animationFrame.rotation, t));
+                node->transform.setScale(Util::lerp(node->transform.getScale(), animationFrame.scale, t));
 
-                if (compareVectors(node->transform.position, animationFrame.position, 0.1f)
-                    && compareVectors(node->transform.eulerRotation, animationFrame.rotation, 0.1f)
-                    && compareVectors(node->transform.scale, animationFrame.scale, 0.1f)) {
+                if (compareVectors(node->transform.getLocalPosition(), animationFrame.position, 0.1f)
+                    && compareVectors(node->transform.getEulerRotation(), animationFrame.rotation, 0.1f)
+                    && compareVectors(node->transform.getScale(), animationFrame.scale, 0.1f)) {
                     node->transform.setLocalPosition(animationFrame.position);
                     node->transform.setEulerRotation(animationFrame.rotation);
                     node->transform.setScale(animationFrame.scale);
@@ -0,0 +1,64 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+#include <cfloat>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Axis aligned box. A default constructed box is empty until something is added to it.
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool isValid() const {
+        return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+    }
+
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 getCenter() const {
+        return (min + max) * 0.5f;
+    }
+
+    glm::vec3 getExtents() const {
+        return (max - min) * 0.5f;
+    }
+
+    float getSurfaceArea() const {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // box around this box after the transform, by projecting the extents onto the new axes
+    AABB transformed(const glm::mat4& m) const {
+        if (!isValid()) return *this;
+        const glm::vec3 center = glm::vec3(m * glm::vec4(getCenter(), 1.0f));
+        const glm::vec3 e = getExtents();
+        glm::vec3 extents;
+        for (int i = 0; i < 3; i++) {
+            extents[i] = std::abs(m[0][i]) * e.x + std::abs(m[1][i]) * e.y + std::abs(m[2][i]) * e.z;
+        }
+        AABB result;
+        result.min = center - extents;
+        result.max = center + extents;
+        return result;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+#endif //BOUNDS_H
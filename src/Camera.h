@@ -8,6 +8,8 @@
 #include <iostream>
 #include <glm/trigonometric.hpp>
 #include <glm/vec3.hpp>
+
+#include "Frustum.h"
 // #include <glm/detail/func_geometric.inl>
 
 enum Camera_Movement {
@@ -23,6 +25,8 @@ const float PITCH       =  0.0f;
 const float SPEED       =  12.5f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  1.0f;
+// vertical field of view of the projection, in degrees
+const float FOV         =  60.0f;
 
 const float NORMAL_SPEED = 12.5f;
 const float SPRINT_SPEED = 30.0f;
@@ -71,8 +75,17 @@ public:
 
     }
 
+    // vertical, in degrees
+    float GetFov() const {
+        return FOV;
+    }
+
     glm::mat4 GetProjectionMatrix(float aspectRatio) const {
-        return glm::perspective(glm::radians(60.0f), aspectRatio, NearPlane, FarPlane);
+        return glm::perspective(glm::radians(GetFov()), aspectRatio, NearPlane, FarPlane);
+    }
+
+    Frustum GetFrustum(float aspectRatio) const {
+        return Frustum(GetProjectionMatrix(aspectRatio) * GetViewMatrix());
     }
 
     void setPitch(float v) {
@@ -0,0 +1,127 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef DEFERREDRENDERER_H
+#define DEFERREDRENDERER_H
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "GLStateCache.h"
+#include "Shader.h"
+
+// G-buffer and lighting pass of the deferred path.
+// The geometry pass writes what the lights need per pixel, then one full screen pass lights every pixel with the
+// directional light and the point and spot lights of its froxel (LightClusters), so the cost of a light
+// is paid once per pixel it covers instead of once per mesh drawn under it.
+//   0: RGBA32F world position
+//   1: RGBA16F normal, w is 1 where something was drawn
+//   2: RGBA8   albedo, a is the specular strength
+// The depth is blitted to the default framebuffer afterwards, so materials the G-buffer can't hold
+// (reflective, refractive, emissive) and the skybox are drawn forward on top, depth tested as usual.
+class DeferredRenderer {
+public:
+    static constexpr int POSITION_UNIT = 0;
+    static constexpr int NORMAL_UNIT = 1;
+    static constexpr int ALBEDO_SPECULAR_UNIT = 2;
+
+    int width = 0;
+    int height = 0;
+
+    void create(const char* lightingVertexPath, const char* lightingFragmentPath) {
+        lightingShader = new Shader(lightingVertexPath, lightingFragmentPath);
+        lightingShader->use();
+        lightingShader->setInt("gPosition", POSITION_UNIT);
+        lightingShader->setInt("gNormal", NORMAL_UNIT);
+        lightingShader->setInt("gAlbedoSpec", ALBEDO_SPECULAR_UNIT);
+        lightingShader->setFloat("shininess", 32.0f);
+        // GL core profile draws need a vertex array, even without attributes
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // Reallocates the attachments for a new framebuffer size.
+    void resize(int newWidth, int newHeight) {
+        if (newWidth <= 0 || newHeight <= 0) return;
+        if (newWidth == width && newHeight == height) return;
+        width = newWidth;
+        height = newHeight;
+
+        if (!framebuffer) {
+            glGenFramebuffers(1, &framebuffer);
+            glGenTextures(1, &positionTexture);
+            glGenTextures(1, &normalTexture);
+            glGenTextures(1, &colorTexture);
+            glGenTextures(1, &depthTexture);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        attach(positionTexture, GL_RGBA32F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT0);
+        attach(normalTexture, GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT1);
+        attach(colorTexture, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT2);
+        // same format as the default depth buffer, blitting depth needs them to match
+        attach(depthTexture, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT);
+
+        const GLenum attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            spdlog::error("G-buffer is not complete.");
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Binds and clears the G-buffer. Blending would mix the attributes, it stays off until endGeometry().
+    void beginGeometry() {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        GLStateCache::get().setEnabled(GL_BLEND, false);
+    }
+
+    void endGeometry() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLStateCache::get().setEnabled(GL_BLEND, true);
+    }
+
+    // Lights the G-buffer into the default framebuffer, then copies its depth there for the forward pass.
+    // The cluster grid and light buffers must be bound already.
+    void light() {
+        GLStateCache& state = GLStateCache::get();
+        state.setEnabled(GL_DEPTH_TEST, false);
+        state.polygonMode(GL_FILL);
+        lightingShader->use();
+        state.bindTexture(POSITION_UNIT, GL_TEXTURE_2D, positionTexture);
+        state.bindTexture(NORMAL_UNIT, GL_TEXTURE_2D, normalTexture);
+        state.bindTexture(ALBEDO_SPECULAR_UNIT, GL_TEXTURE_2D, colorTexture);
+        state.bindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        state.setEnabled(GL_DEPTH_TEST, true);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    Shader* getLightingShader() const {
+        return lightingShader;
+    }
+
+private:
+    unsigned int framebuffer = 0;
+    unsigned int positionTexture = 0;
+    unsigned int normalTexture = 0;
+    unsigned int colorTexture = 0;
+    unsigned int depthTexture = 0;
+    unsigned int emptyVAO = 0;
+    Shader* lightingShader = nullptr;
+
+    void attach(unsigned int texture, GLint internalFormat, GLenum format, GLenum type, GLenum attachment) {
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, 0);
+    }
+};
+
+#endif //DEFERREDRENDERER_H
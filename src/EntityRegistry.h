@@ -0,0 +1,188 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef ENTITYREGISTRY_H
+#define ENTITYREGISTRY_H
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "Mesh.h"
+#include "TransformStore.h"
+
+class Instance;
+class Light;
+class Model;
+class PrefabInstancer;
+
+// Entities are the stable NodeRegistry ids, so every Node is also an entity.
+using Entity = uint32_t;
+
+// Components. Each one lives in its own dense array and only exists on entities that need it.
+struct TransformComponent {
+    TransformStore::Handle handle;    // the matrices themselves stay in the TransformStore
+};
+
+struct Renderable {
+    Model* model = nullptr;
+    Material material = STANDARD;
+    uint8_t lod = 0;    // level picked this frame, kept for the hysteresis
+};
+
+struct LightComponent {
+    Light* light = nullptr;
+};
+
+struct InstanceComponent {
+    Instance* instance = nullptr;
+};
+
+// the node's world matrix is the transform of one record of a prefab instancer
+struct PrefabComponent {
+    PrefabInstancer* instancer = nullptr;
+    uint32_t record = 0;
+};
+
+// spins around the local Y axis every frame
+struct Animated {
+    float rotationSpeed = 0.0f;
+};
+
+// rasterized into the occlusion buffer, using the model, the instance's model or the prefab's first part
+struct Occluder {
+};
+
+// Sparse set: entity -> index into the dense arrays. Removing swaps the last element in,
+// so the components stay packed and iteration never visits entities without the component.
+template<typename T>
+class ComponentPool {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    std::vector<Entity> entities;
+    std::vector<T> components;
+    uint32_t version = 0;    // bumped whenever an entity gains or loses the component
+
+    T& add(Entity entity, const T& component = T()) {
+        if (entity >= sparse.size()) sparse.resize(entity + 1, NONE);
+        if (sparse[entity] != NONE) {
+            components[sparse[entity]] = component;
+            return components[sparse[entity]];
+        }
+        sparse[entity] = static_cast<uint32_t>(entities.size());
+        version++;
+        entities.push_back(entity);
+        components.push_back(component);
+        return components.back();
+    }
+
+    void remove(Entity entity) {
+        if (!has(entity)) return;
+        const uint32_t index = sparse[entity];
+        const Entity last = entities.back();
+        entities[index] = last;
+        components[index] = components.back();
+        sparse[last] = index;
+        entities.pop_back();
+        components.pop_back();
+        sparse[entity] = NONE;
+        version++;
+    }
+
+    bool has(Entity entity) const {
+        return entity < sparse.size() && sparse[entity] != NONE;
+    }
+
+    T& get(Entity entity) {
+        return components[sparse[entity]];
+    }
+
+    // nullptr when the entity does not have the component
+    T* find(Entity entity) {
+        return has(entity) ? &components[sparse[entity]] : nullptr;
+    }
+
+    size_t size() const {
+        return entities.size();
+    }
+
+private:
+    std::vector<uint32_t> sparse;
+};
+
+// Owns one pool per component type. Systems walk a view instead of the node tree.
+class EntityRegistry {
+public:
+    static EntityRegistry& get() {
+        static EntityRegistry registry;
+        return registry;
+    }
+
+    template<typename T>
+    ComponentPool<T>& pool() {
+        return std::get<ComponentPool<T>>(pools);
+    }
+
+    template<typename T>
+    T& add(Entity entity, const T& component = T()) {
+        return pool<T>().add(entity, component);
+    }
+
+    template<typename T>
+    void remove(Entity entity) {
+        pool<T>().remove(entity);
+    }
+
+    template<typename T>
+    T* find(Entity entity) {
+        return pool<T>().find(entity);
+    }
+
+    void destroy(Entity entity) {
+        std::apply([entity](auto&... pool) { (pool.remove(entity), ...); }, pools);
+    }
+
+    // Iterates the dense array of the first component and calls fn(entity, First&, Rest&...)
+    // for entities that also have the rest. Put the rarest component first.
+    template<typename First, typename... Rest>
+    class View {
+    public:
+        explicit View(EntityRegistry& registry) : registry(registry) {
+        }
+
+        template<typename Fn>
+        void each(Fn&& fn) {
+            ComponentPool<First>& first = registry.pool<First>();
+            for (size_t i = 0; i < first.entities.size(); i++) {
+                const Entity entity = first.entities[i];
+                if ((registry.pool<Rest>().has(entity) && ...)) {
+                    fn(entity, first.components[i], registry.pool<Rest>().get(entity)...);
+                }
+            }
+        }
+
+    private:
+        EntityRegistry& registry;
+    };
+
+    template<typename First, typename... Rest>
+    View<First, Rest...> view() {
+        return View<First, Rest...>(*this);
+    }
+
+private:
+    std::tuple<
+        ComponentPool<TransformComponent>,
+        ComponentPool<Renderable>,
+        ComponentPool<LightComponent>,
+        ComponentPool<InstanceComponent>,
+        ComponentPool<PrefabComponent>,
+        ComponentPool<Animated>,
+        ComponentPool<Occluder>
+    > pools;
+
+    EntityRegistry() = default;
+};
+
+#endif //ENTITYREGISTRY_H
@@ -0,0 +1,60 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "GLStateCache.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+
+// CPU copy of the FrameUniforms block, std140: matrices are four vec4 columns and vec3s are padded to vec4,
+// so everything here is already 16 byte aligned. Keep in sync with the block in the shaders:
+//
+// layout (std140) uniform FrameUniforms {
+//     mat4 view;
+//     mat4 projection;
+//     mat4 viewProjection;
+//     vec4 cameraPosition;    // w unused
+//     vec4 time;              // x seconds since start, y frame delta
+// };
+struct FrameUniformData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition;
+    glm::vec4 time;
+};
+static_assert(sizeof(FrameUniformData) == 3 * 64 + 2 * 16, "FrameUniformData must match the std140 block");
+
+// Camera and time for every program in one uniform buffer, uploaded once per frame.
+// Each frame writes a fresh range of a streaming buffer and binds it at FRAME_UNIFORMS_BINDING,
+// Shader points its FrameUniforms block there at link time.
+class FrameUniforms {
+public:
+    FrameUniformData data{};
+
+    void create() {
+        stream.create(GL_UNIFORM_BUFFER, sizeof(FrameUniformData));
+    }
+
+    void update(const Camera& camera, float aspectRatio, float time, float deltaTime) {
+        data.view = camera.GetViewMatrix();
+        data.projection = camera.GetProjectionMatrix(aspectRatio);
+        data.viewProjection = data.projection * data.view;
+        data.cameraPosition = glm::vec4(camera.Position, 1.0f);
+        data.time = glm::vec4(time, deltaTime, 0.0f, 0.0f);
+
+        const size_t offset = stream.write(&data, sizeof(FrameUniformData), StreamingBuffer::getUniformAlignment());
+        GLStateCache::get().bindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, stream.getBuffer(), offset, sizeof(FrameUniformData));
+    }
+
+private:
+    StreamingBuffer stream;
+};
+
+#endif //FRAMEUNIFORMS_H
@@ -0,0 +1,67 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+// The six planes of a view-projection matrix, normals pointing inwards.
+class Frustum {
+public:
+    enum Result {
+        OUTSIDE,
+        INTERSECTS,
+        INSIDE
+    };
+
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    // Gribb/Hartmann: every plane is the sum or difference of the last row and one of the others
+    explicit Frustum(const glm::mat4& viewProjection) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+        planes[0] = rows[3] + rows[0];   // left
+        planes[1] = rows[3] - rows[0];   // right
+        planes[2] = rows[3] + rows[1];   // bottom
+        planes[3] = rows[3] - rows[1];   // top
+        planes[4] = rows[3] + rows[2];   // near
+        planes[5] = rows[3] - rows[2];   // far
+        for (glm::vec4& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    Result classify(const AABB& box) const {
+        const glm::vec3 center = box.getCenter();
+        const glm::vec3 extents = box.getExtents();
+        Result result = INSIDE;
+        for (const glm::vec4& plane : planes) {
+            const glm::vec3 normal(plane);
+            const float distance = glm::dot(normal, center) + plane.w;
+            const float radius = glm::dot(glm::abs(normal), extents);
+            if (distance + radius < 0.0f) return OUTSIDE;
+            if (distance - radius < 0.0f) result = INTERSECTS;
+        }
+        return result;
+    }
+
+    bool intersects(const AABB& box) const {
+        return classify(box) != OUTSIDE;
+    }
+
+    bool intersects(const BoundingSphere& sphere) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+        }
+        return true;
+    }
+};
+
+#endif //FRUSTUM_H
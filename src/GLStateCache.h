@@ -0,0 +1,213 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+#include <cstddef>
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the draw code touches. A call that would set what is already set is dropped
+// before it reaches the driver, so draws don't need to restore defaults after themselves.
+// Everything that changes this state has to go through here, or call invalidate() afterwards.
+// ImGui's backend is fine, it restores what it changes.
+//
+// The element array buffer is part of the bound vertex array, it's passed through without being cached.
+class GLStateCache {
+public:
+    static constexpr int MAX_TEXTURE_UNITS = 16;
+
+    // state changes sent to GL and dropped since resetStats(), for the inspector
+    size_t issuedCount = 0;
+    size_t filteredCount = 0;
+
+    static GLStateCache& get() {
+        static GLStateCache cache;
+        return cache;
+    }
+
+    void resetStats() {
+        issuedCount = 0;
+        filteredCount = 0;
+    }
+
+    // Forgets everything, the next call of each kind is issued.
+    void invalidate() {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        for (unsigned int& buffer : buffers) buffer = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (auto& unit : textures) {
+            for (unsigned int& texture : unit) texture = UNKNOWN;
+        }
+        polygon = UNKNOWN;
+        for (int& capability : capabilities) capability = -1;
+        depth = UNKNOWN;
+        depthWrite = -1;
+        blendSource = UNKNOWN;
+        blendDestination = UNKNOWN;
+    }
+
+    // false only when another program is known to be bound
+    bool mayBeBound(unsigned int programId) const {
+        return program == programId || program == UNKNOWN;
+    }
+
+    void useProgram(unsigned int id) {
+        if (filter(program, id)) return;
+        glUseProgram(id);
+    }
+
+    void bindVertexArray(unsigned int id) {
+        if (filter(vertexArray, id)) return;
+        glBindVertexArray(id);
+    }
+
+    void bindBuffer(GLenum target, unsigned int id) {
+        const int slot = bufferSlot(target);
+        if (slot >= 0 && filter(buffers[slot], id)) return;
+        if (slot < 0) issuedCount++;
+        glBindBuffer(target, id);
+    }
+
+    // binds the indexed binding point, which also replaces the buffer bound to the target
+    void bindBufferBase(GLenum target, unsigned int index, unsigned int id) {
+        const int slot = bufferSlot(target);
+        if (slot >= 0) buffers[slot] = id;
+        issuedCount++;
+        glBindBufferBase(target, index, id);
+    }
+
+    // same for a range of the buffer, ranges move every frame so this isn't filtered either
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int id, size_t offset, size_t size) {
+        const int slot = bufferSlot(target);
+        if (slot >= 0) buffers[slot] = id;
+        issuedCount++;
+        glBindBufferRange(target, index, id, offset, size);
+    }
+
+    void activeTexture(int unit) {
+        if (filter(activeUnit, static_cast<unsigned int>(unit))) return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // Binds the texture to the unit, switching the active unit only when the binding changes.
+    void bindTexture(int unit, GLenum target, unsigned int id) {
+        const int slot = textureSlot(target);
+        if (slot >= 0 && unit < MAX_TEXTURE_UNITS && filter(textures[unit][slot], id)) return;
+        if (slot < 0 || unit >= MAX_TEXTURE_UNITS) issuedCount++;
+        activeTexture(unit);
+        glBindTexture(target, id);
+    }
+
+    void polygonMode(GLenum mode) {
+        if (filter(polygon, mode)) return;
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+
+    // GL_DEPTH_TEST, GL_BLEND and GL_CULL_FACE are cached, other capabilities are passed through
+    void setEnabled(GLenum capability, bool enabled) {
+        const int slot = capabilitySlot(capability);
+        if (slot >= 0) {
+            if (capabilities[slot] == static_cast<int>(enabled)) {
+                filteredCount++;
+                return;
+            }
+            capabilities[slot] = enabled;
+        }
+        issuedCount++;
+        if (enabled) glEnable(capability);
+        else glDisable(capability);
+    }
+
+    void depthFunc(GLenum func) {
+        if (filter(depth, func)) return;
+        glDepthFunc(func);
+    }
+
+    void depthMask(bool write) {
+        if (depthWrite == static_cast<int>(write)) {
+            filteredCount++;
+            return;
+        }
+        depthWrite = write;
+        issuedCount++;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void blendFunc(GLenum source, GLenum destination) {
+        if (blendSource == source && blendDestination == destination) {
+            filteredCount++;
+            return;
+        }
+        blendSource = source;
+        blendDestination = destination;
+        issuedCount++;
+        glBlendFunc(source, destination);
+    }
+
+private:
+    static constexpr unsigned int UNKNOWN = ~0u;
+    // GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER
+    static constexpr int BUFFER_TARGETS = 3;
+    // GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER
+    static constexpr int TEXTURE_TARGETS = 3;
+    // GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE
+    static constexpr int CAPABILITIES = 3;
+
+    unsigned int program = UNKNOWN;
+    unsigned int vertexArray = UNKNOWN;
+    unsigned int buffers[BUFFER_TARGETS];
+    unsigned int activeUnit = UNKNOWN;
+    unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    unsigned int polygon = UNKNOWN;
+    int capabilities[CAPABILITIES];     // -1 unknown
+    unsigned int depth = UNKNOWN;
+    int depthWrite = -1;
+    unsigned int blendSource = UNKNOWN;
+    unsigned int blendDestination = UNKNOWN;
+
+    GLStateCache() {
+        invalidate();
+    }
+
+    // true when the call can be dropped, otherwise records the new value
+    bool filter(unsigned int& current, unsigned int value) {
+        if (current == value) {
+            filteredCount++;
+            return true;
+        }
+        current = value;
+        issuedCount++;
+        return false;
+    }
+
+    static int bufferSlot(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER: return 0;
+            case GL_UNIFORM_BUFFER: return 1;
+            case GL_TEXTURE_BUFFER: return 2;
+            default: return -1;
+        }
+    }
+
+    static int textureSlot(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D: return 0;
+            case GL_TEXTURE_CUBE_MAP: return 1;
+            case GL_TEXTURE_BUFFER: return 2;
+            default: return -1;
+        }
+    }
+
+    static int capabilitySlot(GLenum capability) {
+        switch (capability) {
+            case GL_DEPTH_TEST: return 0;
+            case GL_BLEND: return 1;
+            case GL_CULL_FACE: return 2;
+            default: return -1;
+        }
+    }
+};
+
+#endif //GLSTATECACHE_H
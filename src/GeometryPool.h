@@ -0,0 +1,189 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef GEOMETRYPOOL_H
+#define GEOMETRYPOOL_H
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+#include "GLStateCache.h"
+#include "Mesh.h"
+#include "VertexFormat.h"
+
+// One vertex buffer and one element buffer shared by many meshes, with a vertex array describing their format over them.
+struct GeometryBlock {
+    VertexFormat::Format format = VertexFormat::FULL;
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    unsigned int instancingVAO = 0;    // see GeometryPool::getInstancingVertexArray, 0 until first used
+    size_t vertexCapacity = 0;
+    size_t indexCapacity = 0;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+};
+
+// Where a mesh ended up. Its indices stay relative to its own vertices, the draw adds baseVertex.
+struct GeometryRange {
+    int block = -1;
+    int baseVertex = 0;
+    unsigned int firstIndex = 0;
+};
+
+// Per instance data of the instanced shaders that take more than a matrix: the model matrix at attributes 3 to 6
+// and a color at 7.
+struct InstanceAttributes {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+// Sub-allocates the static meshes from a few large buffers. Meshes in the same block share the vertex array,
+// so draws of different models one after another need no vertex array or buffer switch, only a different
+// base vertex and index offset (glDrawElementsBaseVertex).
+// Space is handed out front to back and never given back, meshes live as long as the program.
+// Every block holds one vertex format, a mesh goes to the first block of its format with room.
+class GeometryPool {
+public:
+    // 3.5 MB of compact vertices (11 MB of full ones) and 2 MB of indices, a larger mesh gets a block of its own size
+    static constexpr size_t BLOCK_VERTICES = 1 << 17;
+    static constexpr size_t BLOCK_INDICES = 1 << 19;
+
+    static GeometryPool& get() {
+        static GeometryPool pool;
+        return pool;
+    }
+
+    // Copies the vertices, packed in the format, and, one after another, both index lists into the first block
+    // of that format with room for them.
+    GeometryRange allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                           const std::vector<unsigned int>& moreIndices, VertexFormat::Format format = VertexFormat::FULL) {
+        const size_t indexCount = indices.size() + moreIndices.size();
+        size_t block = 0;
+        while (block < blocks.size() && (blocks[block].format != format ||
+                                         blocks[block].vertexCount + vertices.size() > blocks[block].vertexCapacity ||
+                                         blocks[block].indexCount + indexCount > blocks[block].indexCapacity)) {
+            block++;
+        }
+        if (block == blocks.size()) {
+            createBlock(format, std::max(BLOCK_VERTICES, vertices.size()), std::max(BLOCK_INDICES, indexCount));
+        }
+
+        GeometryBlock& target = blocks[block];
+        GeometryRange range;
+        range.block = static_cast<int>(block);
+        range.baseVertex = static_cast<int>(target.vertexCount);
+        range.firstIndex = static_cast<unsigned int>(target.indexCount);
+
+        const size_t stride = VertexFormat::stride(format);
+        GLStateCache& state = GLStateCache::get();
+        state.bindVertexArray(target.VAO);
+        if (!vertices.empty()) {
+            VertexFormat::pack(format, vertices, packed);
+            state.bindBuffer(GL_ARRAY_BUFFER, target.VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, target.vertexCount * stride, packed.size(), packed.data());
+        }
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, target.EBO);
+        if (!indices.empty()) {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, target.indexCount * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+        }
+        if (!moreIndices.empty()) {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (target.indexCount + indices.size()) * sizeof(unsigned int),
+                            moreIndices.size() * sizeof(unsigned int), moreIndices.data());
+        }
+        state.bindVertexArray(0);
+
+        target.vertexCount += vertices.size();
+        target.indexCount += indexCount;
+        usedBytes += vertices.size() * stride + indexCount * sizeof(unsigned int);
+        return range;
+    }
+
+    const GeometryBlock& getBlock(int block) const {
+        return blocks[block];
+    }
+
+    size_t blockCount() const {
+        return blocks.size();
+    }
+
+    // A vertex array of its own over a block's buffers, for draws that need more attributes,
+    // like the instance transforms of InstanceManager.
+    unsigned int createVertexArray(int block) {
+        unsigned int VAO;
+        glGenVertexArrays(1, &VAO);
+        describeVertex(VAO, blocks[block].VBO, blocks[block].EBO, blocks[block].format);
+        return VAO;
+    }
+
+    // A vertex array over a block's buffers whose attributes 3 to 7 step once per instance, shared by everything
+    // that draws instances of the block's meshes from InstanceAttributes.
+    unsigned int getInstancingVertexArray(int block) {
+        GeometryBlock& target = blocks[block];
+        if (!target.instancingVAO) {
+            target.instancingVAO = createVertexArray(block);
+            GLStateCache::get().bindVertexArray(target.instancingVAO);
+            for (unsigned int attribute = 3; attribute <= 7; attribute++) {
+                glEnableVertexAttribArray(attribute);
+                glVertexAttribDivisor(attribute, 1);
+            }
+        }
+        return target.instancingVAO;
+    }
+
+    // Points attributes 3 to 7 of the bound vertex array at the InstanceAttributes offset bytes into buffer.
+    // GL 4.1 has no base instance, this is how an instanced draw picks its first instance.
+    static void pointInstanceAttributes(unsigned int buffer, size_t offset) {
+        GLStateCache::get().bindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (unsigned int column = 0; column < 4; column++) {
+            glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceAttributes), (void*)(offset + column * sizeof(glm::vec4)));
+        }
+        glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceAttributes), (void*)(offset + offsetof(InstanceAttributes, color)));
+    }
+
+    // Points attributes 0 to 6 of the vertex array at the format's layout in VBO.
+    static void describeVertex(unsigned int VAO, unsigned int VBO, unsigned int EBO, VertexFormat::Format format = VertexFormat::FULL) {
+        GLStateCache& state = GLStateCache::get();
+        state.bindVertexArray(VAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        VertexFormat::describe(format);
+        state.bindVertexArray(0);
+    }
+
+    // bytes taken by meshes and bytes allocated on the GPU, for the inspector
+    size_t usedBytes = 0;
+    size_t reservedBytes = 0;
+
+private:
+    std::vector<GeometryBlock> blocks;
+    std::vector<unsigned char> packed;    // reused between allocations
+
+    GeometryPool() = default;
+
+    void createBlock(VertexFormat::Format format, size_t vertexCapacity, size_t indexCapacity) {
+        GeometryBlock block;
+        block.format = format;
+        block.vertexCapacity = vertexCapacity;
+        block.indexCapacity = indexCapacity;
+        glGenVertexArrays(1, &block.VAO);
+        glGenBuffers(1, &block.VBO);
+        glGenBuffers(1, &block.EBO);
+
+        GLStateCache& state = GLStateCache::get();
+        state.bindVertexArray(block.VAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, block.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCapacity * VertexFormat::stride(format), nullptr, GL_STATIC_DRAW);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, block.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+        state.bindVertexArray(0);
+        describeVertex(block.VAO, block.VBO, block.EBO, format);
+
+        reservedBytes += vertexCapacity * VertexFormat::stride(format) + indexCapacity * sizeof(unsigned int);
+        blocks.push_back(block);
+    }
+};
+
+#endif //GEOMETRYPOOL_H
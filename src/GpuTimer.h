@@ -0,0 +1,49 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+#include <glad/glad.h>
+
+// GPU time of one pass, measured with GL_TIME_ELAPSED queries. Each frame uses the next query of a small ring
+// and reads the oldest one back, so the result lags a few frames but the CPU never waits for the GPU.
+// Time elapsed queries can't nest, timers must begin and end one after another.
+class GpuTimer {
+public:
+    static constexpr int LATENCY = 3;
+
+    // last finished measurement
+    float milliseconds = 0.0f;
+
+    void begin() {
+        if (!queries[0]) glGenQueries(LATENCY, queries);
+        collect();
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[current] = true;
+        current = (current + 1) % LATENCY;
+    }
+
+private:
+    unsigned int queries[LATENCY] = {};
+    bool pending[LATENCY] = {};
+    int current = 0;
+
+    // The query about to be reused is the oldest one. If it still isn't done its result is dropped.
+    void collect() {
+        if (!pending[current]) return;
+        pending[current] = false;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &nanoseconds);
+        milliseconds = static_cast<float>(nanoseconds) / 1000000.0f;
+    }
+};
+
+#endif //GPUTIMER_H
@@ -4,6 +4,7 @@
 
 #ifndef INSTANCE_H
 #define INSTANCE_H
+#include "GLStateCache.h"
 #include "InstanceManager.h"
 #include "Model.h"
 
@@ -24,13 +25,11 @@ public:
     void Draw(Shader& shader) {
         shader.use();
         shader.setInt("texture_diffuse1", 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, model.textureLoaded[0].id); // note: we also made the textures_loaded vector public (instead of private) from the model class.
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, model.textureLoaded[0].id); // note: we also made the textures_loaded vector public (instead of private) from the model class.
         for (unsigned int i = 0; i < model.meshes.size(); i++)
         {
-            glBindVertexArray(model.meshes[i].VAO);
-            glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(model.meshes[i].indices.size()), GL_UNSIGNED_INT, 0, 2);
-            glBindVertexArray(0);
+            GLStateCache::get().bindVertexArray(model.meshes[i].VAO);
+            model.meshes[i].drawElementsInstanced(0, 2);
         }
     }
 
@@ -4,89 +4,489 @@
 
 #ifndef INSTANCEMANAGER_H
 #define INSTANCEMANAGER_H
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include "Frustum.h"
+#include "GeometryPool.h"
+#include "GLStateCache.h"
+#include "Lod.h"
+#include "OcclusionBuffer.h"
 #include "Node.h"
+#include "Simd.h"
+#include "StreamingBuffer.h"
+#include "ThreadPool.h"
 
 class InstanceManager {
 
 
 public:
+    // How each instance transform is laid out on the GPU. The instanced vertex shaders rebuild the matrix,
+    // they are compiled per format with the define from formatDefine().
+    enum Format {
+        MATRIX,         // the whole mat4, attributes 3 to 6, 64 bytes
+        AFFINE,         // the top three rows, attributes 3 to 5, 48 bytes
+        QUATERNION,     // position and uniform scale in attribute 3, snorm16 rotation in 4, 24 bytes
+    };
+    static constexpr int FORMAT_COUNT = 3;
+
+    struct AffineInstance {
+        glm::vec4 rows[3];
+    };
+
+    struct QuaternionInstance {
+        glm::vec3 position;
+        float scale;
+        int16_t rotation[4];
+    };
+
     std::vector<glm::mat4> modelMatrices;
     Model& model;
-    bool isDirty = false;
-    unsigned int buffer;
+    unsigned int buffer = 0;
 
+    // dirty runs closer than this many matrices are merged into one upload
+    static constexpr int MERGE_GAP = 16;
 
-    InstanceManager(Model& model): model(model) {
+    bool cullingEnabled = true;
+    // result of the last cull(), for the stats
+    size_t visibleCount = 0;
+    // visible instances per LOD after the last selectLods()
+    size_t lodCounts[Mesh::MAX_LODS] = {};
+
+
+    InstanceManager(Model& model, Format format = MATRIX): model(model), format(format) {
+    }
+
+    static size_t formatStride(Format format) {
+        switch (format) {
+            case AFFINE: return sizeof(AffineInstance);
+            case QUATERNION: return sizeof(QuaternionInstance);
+            default: return sizeof(glm::mat4);
+        }
+    }
+
+    static const char* formatDefine(Format format) {
+        switch (format) {
+            case AFFINE: return "INSTANCE_AFFINE";
+            case QUATERNION: return "INSTANCE_QUATERNION";
+            default: return nullptr;
+        }
+    }
+
+    Format getFormat() const {
+        return format;
+    }
+
+    // QUATERNION drops shear and non-uniform scale, only use it for instances that have neither.
+    void setFormat(Format format) {
+        if (this->format == format) return;
+        this->format = format;
+        if (!buffer) return;
+        upload();
+        attributeSource = 0;
     }
 
     void addMatrix(glm::mat4 m) {
         modelMatrices.push_back(m);
+        dirtyFlags.push_back(0);
+        instanceLods.push_back(0);
+
+        // keep the sphere arrays padded to whole groups of four, padding never passes the test
+        const size_t padded = (modelMatrices.size() + 3) & ~size_t(3);
+        sphereX.resize(padded, 0.0f);
+        sphereY.resize(padded, 0.0f);
+        sphereZ.resize(padded, 0.0f);
+        sphereRadius.resize(padded, -FLT_MAX);
+        updateSphere(modelMatrices.size() - 1);
     }
 
     void setModel(Model& model) {
         this->model = model;
+        if (!vertexArrays.empty()) {
+            // unbound first, so the state cache can't hold on to a name GL may hand out again
+            GLStateCache::get().bindVertexArray(0);
+            glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+            vertexArrays.clear();
+            attributeSource = 0;
+        }
+        for (size_t i = 0; i < modelMatrices.size(); i++) {
+            updateSphere(i);
+        }
     }
 
-    void updateModelMatrix(int id, glm::mat4 m) {
+    void updateModelMatrix(int id, const glm::mat4& m) {
         modelMatrices[id] = m;
+        updateSphere(id);
+        if (!dirtyFlags[id]) {
+            dirtyFlags[id] = 1;
+            dirtyIds.push_back(id);
+        }
+    }
+
+    bool isDirty() const {
+        return !dirtyIds.empty();
     }
 
     void instantiate() {
         glGenBuffers(1, &buffer);
-        glBindBuffer(GL_ARRAY_BUFFER, buffer);
-        glBufferData(GL_ARRAY_BUFFER, modelMatrices.size() * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
+        upload();
 
+        // room for staging every matrix and for the visible list in the same frame, in the largest format
+        stream.create(GL_ARRAY_BUFFER, 2 * modelMatrices.size() * sizeof(glm::mat4));
+        bindInstanceAttributes(buffer);
+
+        std::cout << "Instantiated instance " << std::endl;
+    }
+
+    // Tests every instance's bounding sphere against the frustum, four at a time, and collects the
+    // visible ids in order. With a pool, blocks of grainSize instances are tested in parallel.
+    void cull(const Frustum& frustum, ThreadPool* pool = nullptr, size_t grainSize = 4096) {
+        const size_t count = modelMatrices.size();
+        if (!cullingEnabled) {
+            visibleCount = count;
+            return;
+        }
+
+        grainSize = (grainSize + 3) & ~size_t(3);
+        forEachChunk(count, grainSize, pool, [this, &frustum](size_t begin, size_t end, std::vector<uint32_t>& out) {
+            cullRange(frustum, begin, end, out);
+        });
+    }
+
+    // Drops the instances that survived cull() but are hidden behind the occluders in the buffer.
+    void occlude(const OcclusionBuffer& occlusion, ThreadPool* pool = nullptr, size_t grainSize = 1024) {
+        if (!cullingEnabled) return;
+        forEachChunk(visibleIds.size(), grainSize, pool, [this, &occlusion](size_t begin, size_t end, std::vector<uint32_t>& out) {
+            out.clear();
+            for (size_t k = begin; k < end; k++) {
+                const uint32_t id = visibleIds[k];
+                const glm::vec3 center(sphereX[id], sphereY[id], sphereZ[id]);
+                AABB box;
+                box.min = center - glm::vec3(sphereRadius[id]);
+                box.max = center + glm::vec3(sphereRadius[id]);
+                if (occlusion.isVisible(box)) out.push_back(id);
+            }
+        });
+    }
+
+    // Buckets the instances that survived cull() by LOD. Draw() then issues one instanced draw per level.
+    void selectLods(const glm::vec3& cameraPosition, const LodSettings& settings) {
+        const int lodCount = std::min(model.getLodCount(), Mesh::MAX_LODS);
+        lodsSelected = settings.enabled && lodCount > 1;
+        std::fill(std::begin(lodCounts), std::end(lodCounts), 0);
+        if (!lodsSelected) return;
+
+        for (std::vector<uint32_t>& bucket : lodBuckets) bucket.clear();
+        lodBuckets.resize(lodCount);
+
+        const float radius = std::max(model.sphere.radius, 0.0001f);
+        auto place = [&](uint32_t id) {
+            const glm::vec3 center(sphereX[id], sphereY[id], sphereZ[id]);
+            const float distance = LodSettings::sphereDistance(cameraPosition, center, sphereRadius[id]);
+            const int lod = settings.select(model, sphereRadius[id] / radius, distance, instanceLods[id]);
+            instanceLods[id] = static_cast<uint8_t>(lod);
+            lodBuckets[lod].push_back(id);
+        };
+        if (cullingEnabled) {
+            for (uint32_t id : visibleIds) place(id);
+        } else {
+            for (uint32_t id = 0; id < modelMatrices.size(); id++) place(id);
+        }
+        for (int lod = 0; lod < lodCount; lod++) {
+            lodCounts[lod] = lodBuckets[lod].size();
+        }
+    }
+
+    // Points the instance attributes of every mesh at the given buffer, starting offset bytes in.
+    void bindInstanceAttributes(unsigned int source, size_t offset = 0) {
+        GLStateCache& state = GLStateCache::get();
+        state.bindBuffer(GL_ARRAY_BUFFER, source);
+        const GLsizei stride = static_cast<GLsizei>(formatStride(format));
+        // vec4 attributes used by the format, the rest of 3 to 6 is switched off
+        const unsigned int used = format == MATRIX ? 4 : format == AFFINE ? 3 : 2;
         for (unsigned int i = 0; i < model.meshes.size(); i++)
         {
-            unsigned int VAO = model.meshes[i].VAO;
-            glBindVertexArray(VAO);
-            // set attribute pointers for matrix (4 times vec4)
-            glEnableVertexAttribArray(3);
-            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-            glEnableVertexAttribArray(4);
-            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-            glEnableVertexAttribArray(5);
-            glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-            glEnableVertexAttribArray(6);
-            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-            glVertexAttribDivisor(3, 1);
-            glVertexAttribDivisor(4, 1);
-            glVertexAttribDivisor(5, 1);
-            glVertexAttribDivisor(6, 1);
-
-            glBindVertexArray(0);
+            state.bindVertexArray(vertexArray(i));
+            for (unsigned int a = 0; a < 4; a++) {
+                if (a >= used) {
+                    glDisableVertexAttribArray(3 + a);
+                    continue;
+                }
+                glEnableVertexAttribArray(3 + a);
+                if (format == QUATERNION && a == 1) {
+                    glVertexAttribPointer(4, 4, GL_SHORT, GL_TRUE, stride, (void*)(offset + offsetof(QuaternionInstance, rotation)));
+                } else {
+                    glVertexAttribPointer(3 + a, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + a * sizeof(glm::vec4)));
+                }
+                glVertexAttribDivisor(3 + a, 1);
+            }
         }
-
-        std::cout << "Instantiated instance " << std::endl;
+        attributeSource = source;
+        attributeOffset = offset;
     }
 
+    // Uploads only the matrices touched since the last call, as a few merged ranges. The ranges are staged
+    // in the streaming buffer and copied over on the GPU, so the draws still reading the buffer don't stall the upload.
     void updateBuffer() {
-        if (!isDirty) return;
+        if (dirtyIds.empty()) return;
+
+        std::sort(dirtyIds.begin(), dirtyIds.end());
+        dirtyRuns.clear();
+        size_t runBegin = 0;
+        size_t stagedCount = 0;
+        for (size_t i = 1; i <= dirtyIds.size(); i++) {
+            if (i < dirtyIds.size() && dirtyIds[i] - dirtyIds[i - 1] <= MERGE_GAP) continue;
+
+            const int first = dirtyIds[runBegin];
+            const int count = dirtyIds[i - 1] - first + 1;
+            dirtyRuns.emplace_back(first, count);
+            stagedCount += count;
+            runBegin = i;
+        }
+
+        const size_t stride = formatStride(format);
+        StreamingBuffer::Allocation staging = stream.map(stagedCount * stride);
+        if (staging.data) {
+            char* out = static_cast<char*>(staging.data);
+            for (const auto& [first, count] : dirtyRuns) {
+                pack([first](size_t k) { return first + k; }, count, out);
+                out += count * stride;
+            }
+            stream.unmap();
 
-        glBindBuffer(GL_ARRAY_BUFFER, buffer); // Ensure the buffer is bound
-        glBufferSubData(GL_ARRAY_BUFFER, 0, modelMatrices.size() * sizeof(glm::mat4), &modelMatrices[0]);
+            GLStateCache::get().bindBuffer(GL_COPY_READ_BUFFER, stream.getBuffer());
+            GLStateCache::get().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            size_t source = staging.offset;
+            for (const auto& [first, count] : dirtyRuns) {
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, first * stride, count * stride);
+                source += count * stride;
+            }
+        }
 
-        isDirty = false; // Reset the flag
+        for (int id : dirtyIds) {
+            dirtyFlags[id] = 0;
+        }
+        dirtyIds.clear();
     }
 
     void Draw(Shader* shader) {
         shader->use();
         // shader->setInt("texture_diffuse", 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, model.textureLoaded[0].id);
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, model.textureLoaded[0].id);
 
         updateBuffer();
 
+        if (lodsSelected) {
+            drawLods();
+            return;
+        }
+
+        // everything visible draws straight from the persistent buffer,
+        // otherwise the visible matrices are packed into the streaming buffer for this frame
+        size_t drawCount = modelMatrices.size();
+        unsigned int source = buffer;
+        size_t offset = 0;
+        if (cullingEnabled && visibleCount < modelMatrices.size()) {
+            if (visibleCount == 0) return;
+            offset = streamVisible();
+            drawCount = visibleCount;
+            source = stream.getBuffer();
+        }
+        if (source != attributeSource || attributeOffset != offset) bindInstanceAttributes(source, offset);
+
         // std::cout << "drawing for " << modelMatrices.size() << std::endl;
         for (unsigned int i = 0; i < model.meshes.size(); i++)
         {
-            glBindVertexArray(model.meshes[i].VAO);
-            glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(model.meshes[i].indices.size()), GL_UNSIGNED_INT, 0, modelMatrices.size());
-            glBindVertexArray(0);
+            GLStateCache::get().bindVertexArray(vertexArray(i));
+            model.meshes[i].drawElementsInstanced(0, drawCount);
         }
     }
 
+private:
+    Format format;
+    std::vector<uint8_t> dirtyFlags;   // per instance, avoids queueing the same id twice
+    std::vector<int> dirtyIds;
+
+    // world space bounding spheres as separate arrays so four instances load with one instruction each
+    std::vector<float> sphereX;
+    std::vector<float> sphereY;
+    std::vector<float> sphereZ;
+    std::vector<float> sphereRadius;
+
+    std::vector<std::vector<uint32_t>> chunkVisible;
+    std::vector<uint32_t> visibleIds;
+    std::vector<std::pair<int, int>> dirtyRuns;     // first, count
+    StreamingBuffer stream;
+    unsigned int attributeSource = 0;
+    size_t attributeOffset = 0;
+    // per mesh of the model, over its vertices with the instance attributes of this manager.
+    // The model's own vertex arrays stay untouched, nodes and the render queue keep drawing through them.
+    std::vector<unsigned int> vertexArrays;
+
+    std::vector<uint8_t> instanceLods;
+    std::vector<std::vector<uint32_t>> lodBuckets;
+    bool lodsSelected = false;
+
+    // Splits [0, count) into blocks, runs fn(begin, end, out) on each, on the pool when there is more than one,
+    // and concatenates the outputs in order into visibleIds.
+    template<typename Fn>
+    void forEachChunk(size_t count, size_t grainSize, ThreadPool* pool, Fn&& fn) {
+        const size_t chunkCount = (count + grainSize - 1) / grainSize;
+        chunkVisible.resize(chunkCount);
+        if (pool && chunkCount > 1) {
+            for (size_t c = 0; c < chunkCount; c++) {
+                pool->submit([&fn, this, c, grainSize, count] {
+                    fn(c * grainSize, std::min(count, (c + 1) * grainSize), chunkVisible[c]);
+                });
+            }
+            pool->wait();
+        } else {
+            for (size_t c = 0; c < chunkCount; c++) {
+                fn(c * grainSize, std::min(count, (c + 1) * grainSize), chunkVisible[c]);
+            }
+        }
+
+        visibleIds.clear();
+        for (size_t c = 0; c < chunkCount; c++) {
+            visibleIds.insert(visibleIds.end(), chunkVisible[c].begin(), chunkVisible[c].end());
+        }
+        visibleCount = visibleIds.size();
+    }
+
+    unsigned int vertexArray(unsigned int mesh) {
+        if (vertexArrays.size() != model.meshes.size()) vertexArrays.resize(model.meshes.size(), 0);
+        unsigned int& VAO = vertexArrays[mesh];
+        if (!VAO) {
+            const Mesh& source = model.meshes[mesh];
+            if (source.geometryBlock >= 0) {
+                VAO = GeometryPool::get().createVertexArray(source.geometryBlock);
+            } else {
+                glGenVertexArrays(1, &VAO);
+                GeometryPool::describeVertex(VAO, source.VBO, source.EBO, source.vertexFormat);
+            }
+        }
+        return VAO;
+    }
+
+    void updateSphere(size_t id) {
+        const glm::mat4& m = modelMatrices[id];
+        const glm::vec3 center = glm::vec3(m * glm::vec4(model.sphere.center, 1.0f));
+        const float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        sphereX[id] = center.x;
+        sphereY[id] = center.y;
+        sphereZ[id] = center.z;
+        sphereRadius[id] = model.sphere.radius * scale;
+    }
+
+    // [begin, end) starts on a multiple of four, the padding past the last instance is always culled
+    void cullRange(const Frustum& frustum, size_t begin, size_t end, std::vector<uint32_t>& out) {
+        simd::float4 planes[6][4];
+        for (int p = 0; p < 6; p++) {
+            planes[p][0] = simd::splat(frustum.planes[p].x);
+            planes[p][1] = simd::splat(frustum.planes[p].y);
+            planes[p][2] = simd::splat(frustum.planes[p].z);
+            planes[p][3] = simd::splat(frustum.planes[p].w);
+        }
+        const simd::float4 zero = simd::splat(0.0f);
+
+        out.clear();
+        for (size_t i = begin; i < end; i += 4) {
+            const simd::float4 x = simd::load(&sphereX[i]);
+            const simd::float4 y = simd::load(&sphereY[i]);
+            const simd::float4 z = simd::load(&sphereZ[i]);
+            const simd::float4 r = simd::load(&sphereRadius[i]);
+
+            // visible while dot(normal, center) + w >= -radius for all six planes
+            simd::float4 mask = simd::cmpge(simd::add(simd::madd(planes[0][0], x, simd::madd(planes[0][1], y, simd::madd(planes[0][2], z, planes[0][3]))), r), zero);
+            for (int p = 1; p < 6; p++) {
+                simd::float4 d = simd::madd(planes[p][0], x, simd::madd(planes[p][1], y, simd::madd(planes[p][2], z, planes[p][3])));
+                mask = simd::maskAnd(mask, simd::cmpge(simd::add(d, r), zero));
+            }
+
+            const int bits = simd::moveMask(mask);
+            if (!bits) continue;
+            for (size_t lane = 0; lane < 4 && i + lane < end; lane++) {
+                if (bits & (1 << lane)) out.push_back(static_cast<uint32_t>(i + lane));
+            }
+        }
+    }
+
+    // Packs count matrices, modelMatrices[id(0)] to modelMatrices[id(count - 1)], into out in the current format.
+    // The format is picked once for the whole batch so the loops stay free of branches.
+    template<typename Id>
+    void pack(Id&& id, size_t count, void* out) const {
+        switch (format) {
+            case AFFINE: {
+                AffineInstance* affine = static_cast<AffineInstance*>(out);
+                for (size_t k = 0; k < count; k++) simd::packAffine(modelMatrices[id(k)], &affine[k].rows[0].x);
+                break;
+            }
+            case QUATERNION: {
+                QuaternionInstance* compact = static_cast<QuaternionInstance*>(out);
+                for (size_t k = 0; k < count; k++) {
+                    simd::packQuaternion(modelMatrices[id(k)], compact[k].position, compact[k].scale, compact[k].rotation);
+                }
+                break;
+            }
+            default: {
+                glm::mat4* matrices = static_cast<glm::mat4*>(out);
+                for (size_t k = 0; k < count; k++) matrices[k] = modelMatrices[id(k)];
+                break;
+            }
+        }
+    }
+
+    // Fills the persistent buffer with every instance in the current format.
+    void upload() {
+        std::vector<char> packed(modelMatrices.size() * formatStride(format));
+        pack([](size_t k) { return k; }, modelMatrices.size(), packed.data());
+        GLStateCache::get().bindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_DYNAMIC_DRAW);
+        for (int id : dirtyIds) {
+            dirtyFlags[id] = 0;
+        }
+        dirtyIds.clear();
+    }
+
+    // Writes this frame's visible instances straight into the streaming buffer, returns their offset.
+    size_t streamVisible() {
+        StreamingBuffer::Allocation allocation = stream.map(visibleIds.size() * formatStride(format));
+        if (allocation.data) pack([this](size_t k) { return visibleIds[k]; }, visibleIds.size(), allocation.data);
+        stream.unmap();
+        return allocation.offset;
+    }
+
+    // Packs the buckets one after another into the streaming buffer. GL 4.1 has no base instance,
+    // so each level re-points the instance attributes at its bucket's offset instead.
+    void drawLods() {
+        size_t total = 0;
+        for (const std::vector<uint32_t>& bucket : lodBuckets) total += bucket.size();
+        if (total == 0) return;
+        const size_t stride = formatStride(format);
+        StreamingBuffer::Allocation allocation = stream.map(total * stride);
+        if (allocation.data) {
+            char* out = static_cast<char*>(allocation.data);
+            for (const std::vector<uint32_t>& bucket : lodBuckets) {
+                pack([&bucket](size_t k) { return bucket[k]; }, bucket.size(), out);
+                out += bucket.size() * stride;
+            }
+        }
+        stream.unmap();
+
+        size_t first = 0;
+        for (int lod = 0; lod < static_cast<int>(lodBuckets.size()); lod++) {
+            const size_t count = lodBuckets[lod].size();
+            if (count == 0) continue;
+            bindInstanceAttributes(stream.getBuffer(), allocation.offset + first * stride);
+            for (unsigned int i = 0; i < model.meshes.size(); i++)
+            {
+                GLStateCache::get().bindVertexArray(vertexArray(i));
+                model.meshes[i].drawElementsInstanced(lod, count);
+            }
+            first += count;
+        }
+    }
 };
 
 #endif //INSTANCEMANAGER_H
@@ -12,8 +12,9 @@ enum Type {
 
 class Light {
 public:
-    int id = 0;
+    int id = 0;    // index in its type's array of the light block, assigned by the LightManager
     bool active = true;
+    glm::vec3 position = glm::vec3(0.0f);
     glm::vec3 direction;
     glm::vec3 diffuse;
     glm::vec3 specular;
@@ -28,156 +29,83 @@ public:
 
     Type type = Type::DIRECTIONAL;
 
-    Shader* shader;
-    Shader* regularShader;
+    // set by every setter, the LightManager repacks dirty lights before its upload
+    bool dirty = true;
 
 public:
-    Light(Type type, Shader* shader, Shader* regularShader, int id) {
-        this->shader = shader;
-        this->regularShader = regularShader;
+    Light(Type type) {
         this->type = type;
-        this->id = id;
-    }
-    //TODO UPDATE DLA REGULAR SHADERA
-    void setForTypeVec3(std::string property, glm::vec3 value) const {
-        shader->use();
-        switch (type) {
-            case DIRECTIONAL:
-                shader->setVec3("dirLight." + property, value);
-                break;
-            case SPOTLIGHT:
-                shader->setVec3("spotLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-            case POINT:
-                shader->setVec3("pointLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-        }
-        regularShader->use();
-        switch (type) {
-            case DIRECTIONAL:
-                regularShader->setVec3("dirLight." + property, value);
-                break;
-            case SPOTLIGHT:
-                regularShader->setVec3("spotLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-            case POINT:
-                regularShader->setVec3("pointLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-        }
-    }
-
-    void setForTypeFloat(std::string property, float value) const {
-        shader->use();
-        switch (type) {
-            case DIRECTIONAL:
-                shader->setFloat("dirLight." + property, value);
-                break;
-            case SPOTLIGHT:
-                shader->setFloat("spotLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-            case POINT:
-                shader->setFloat("pointLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-        }
-        regularShader->use();
-        switch (type) {
-            case DIRECTIONAL:
-                regularShader->setFloat("dirLight." + property, value);
-                break;
-            case SPOTLIGHT:
-                regularShader->setFloat("spotLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-            case POINT:
-                regularShader->setFloat("pointLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-        }
-    }
-
-    void setForTypeBool(std::string property, bool value) const {
-        shader->use();
-        switch (type) {
-            case DIRECTIONAL:
-                shader->setBool("dirLight." + property, value);
-                break;
-            case SPOTLIGHT:
-                shader->setBool("spotLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-            case POINT:
-                shader->setBool("pointLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-        }
-        regularShader->use();
-        switch (type) {
-            case DIRECTIONAL:
-                regularShader->setBool("dirLight." + property, value);
-                break;
-            case SPOTLIGHT:
-                regularShader->setBool("spotLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-            case POINT:
-                regularShader->setBool("pointLights[" + std::to_string(id) + "]."+ property, value);
-                break;
-        }
     }
 
     void setActive(bool v) {
         active = v;
-        setForTypeBool("isOn", v);
+        dirty = true;
     }
 
     void setIntensity(float v) {
         this->intensity = v;
-        setForTypeFloat("intensity", v);
+        dirty = true;
+    }
+
+    // called every frame for lights on nodes, only an actual move needs an upload
+    void setPosition(const glm::vec3 position) {
+        if (position == this->position) return;
+        this->position = position;
+        dirty = true;
     }
 
     void setDirection(glm::vec3 direction) {
         this->direction = direction;
-        setForTypeVec3("direction", direction);
-
+        dirty = true;
     }
 
     void setDiffuse(const glm::vec3 diffuse) {
         this->diffuse = diffuse;
-        setForTypeVec3("diffuse", diffuse);
+        dirty = true;
     }
 
     void setSpecular(const glm::vec3 specular) {
         this->specular = specular;
-        setForTypeVec3("specular", specular);
+        dirty = true;
     }
 
     void setAmbient(const glm::vec3 ambient) {
         this->ambient = ambient;
-        setForTypeVec3("ambient", ambient);
+        dirty = true;
     }
 
     void setConstant(const float constant) {
         this->constant = constant;
-        setForTypeFloat("constant", constant);
+        dirty = true;
     }
 
     void setLinear(const float linear) {
         this->linear = linear;
-        setForTypeFloat("linear", linear);
+        dirty = true;
     }
 
     void setQuadratic(const float quadratic) {
         this->quadratic = quadratic;
-        setForTypeFloat("quadratic", quadratic);
+        dirty = true;
     }
 
     void setCutOff(const float cutOff) {
         this->cutOff = cutOff;
-        setForTypeFloat("cutOff", cutOff);
+        dirty = true;
     }
 
+    // only before the light is added to the LightManager, which keeps it in its type's array
     void setType(const Type type) {
         this->type = type;
     }
 
     void setOuterCutOff(const float outerCutOff) {
         this->outerCutOff = outerCutOff;
-        setForTypeFloat("outerCutOff", outerCutOff);
+        dirty = true;
+    }
+
+    glm::vec3 getPosition() const {
+        return position;
     }
 
     glm::vec3 getDirection() {
@@ -222,11 +150,11 @@ public:
     }
 
     void setCutOffDegrees(float degrees) {
-        this->cutOff = glm::cos(glm::radians(degrees));
+        setCutOff(glm::cos(glm::radians(degrees)));
     }
 
     void setOuterCutOffDegrees(float degrees) {
-        this->outerCutOff = glm::cos(glm::radians(degrees));
+        setOuterCutOff(glm::cos(glm::radians(degrees)));
     }
 
     Type getType() {
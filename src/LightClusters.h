@@ -0,0 +1,262 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLStateCache.h"
+#include "LightManager.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+#include "ThreadPool.h"
+
+// The ClusterUniforms block, std140. Keep in sync with res/shaders/blinnphong/shader.frag.
+struct ClusterBlock {
+    unsigned int gridSize[4];    // tiles in x and y, depth slices
+    glm::vec4 scale;             // tiles per pixel in x and y, slice = log(depth) * z + w
+};
+
+// Clustered forward shading: the view frustum is cut into a grid of froxels, screen tiles in x and y
+// and exponentially growing depth slices, and every froxel gets the list of local lights reaching into it.
+// A fragment finds its froxel from gl_FragCoord and its view depth and only evaluates those lights.
+// Lights are bound by the sphere their range covers. Depth slices are binned in parallel, each task owns
+// the froxels of its slices. The lists go to the GPU as two texture buffers:
+// the grid holds (offset, count) per froxel, the index buffer the concatenated light ids.
+class LightClusters {
+public:
+    static constexpr unsigned int TILES_X = 16;
+    static constexpr unsigned int TILES_Y = 9;
+    static constexpr unsigned int SLICES = 24;
+    static constexpr unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+    // stats of the last build(), for the inspector
+    size_t lightCount = 0;
+    size_t indexCount = 0;
+    size_t maxLightsPerCluster = 0;
+
+    void create() {
+        uniforms.create(GL_UNIFORM_BUFFER, sizeof(ClusterBlock));
+        gridStream.create(GL_TEXTURE_BUFFER, CLUSTER_COUNT * 2 * sizeof(uint32_t), StreamingBuffer::ORPHAN);
+        indexStream.create(GL_TEXTURE_BUFFER, CLUSTER_COUNT * sizeof(uint32_t), StreamingBuffer::ORPHAN);
+        GLStateCache::get().bindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glGenTextures(1, &gridTexture);
+        glGenTextures(1, &indexTexture);
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_BUFFER, gridTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridStream.getBuffer());
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_BUFFER, indexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexStream.getBuffer());
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Bins the local lights of the LightManager, call after its upload().
+    // projection has to be a symmetric perspective, like Camera::GetProjectionMatrix.
+    void build(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+               float viewportWidth, float viewportHeight, ThreadPool* pool = nullptr) {
+        setProjection(projection, nearPlane, farPlane, viewportWidth, viewportHeight);
+        gatherLights(view, LightManager::get().getLocalData());
+
+        // a handful of slices per task keeps every worker busy without too many tiny tasks
+        const unsigned int slicesPerTask = pool ? std::max(1u, SLICES / (pool->size() * 2)) : SLICES;
+        for (unsigned int z = 0; z < SLICES; z += slicesPerTask) {
+            const unsigned int end = std::min(SLICES, z + slicesPerTask);
+            if (pool) pool->submit([this, z, end] { binSlices(z, end); });
+            else binSlices(z, end);
+        }
+        if (pool) pool->wait();
+
+        flatten();
+        upload();
+    }
+
+    // Binds the light data and the cluster lists to their texture units. The units are reserved,
+    // nothing else binds there, so once per frame is enough.
+    void bind() const {
+        GLStateCache& state = GLStateCache::get();
+        state.bindTexture(LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, LightManager::get().getLightTexture());
+        state.bindTexture(CLUSTER_GRID_UNIT, GL_TEXTURE_BUFFER, gridTexture);
+        state.bindTexture(CLUSTER_LIGHTS_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+    }
+
+private:
+    // a local light as the binning sees it, in view space
+    struct LightBounds {
+        glm::vec3 center;     // view space, looking down -z
+        float radius;
+        unsigned int id;
+        unsigned int z0, z1;  // slice range, inclusive
+        unsigned int x0, x1;  // tile ranges, inclusive
+        unsigned int y0, y1;
+    };
+
+    struct Froxel {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    ClusterBlock block{};
+    glm::mat4 projection = glm::mat4(0.0f);
+    float nearPlane = 0.0f;
+    float farPlane = 0.0f;
+    std::vector<Froxel> froxels;                       // view space bounds, rebuilt when the projection changes
+    std::vector<LightBounds> lights;
+    std::vector<std::vector<uint32_t>> clusterLights;  // per froxel, written only by the task owning its slice
+    std::vector<uint32_t> grid;                        // offset, count per froxel
+    std::vector<uint32_t> indices;
+
+    StreamingBuffer uniforms;
+    StreamingBuffer gridStream;
+    StreamingBuffer indexStream;
+    unsigned int gridTexture = 0;
+    unsigned int indexTexture = 0;
+
+    static unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z) {
+        return (z * TILES_Y + y) * TILES_X + x;
+    }
+
+    float sliceDepth(unsigned int z) const {
+        return nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z) / SLICES);
+    }
+
+    unsigned int sliceOf(float depth) const {
+        const float slice = std::log(std::max(depth, nearPlane)) * block.scale.z + block.scale.w;
+        return std::min(SLICES - 1, static_cast<unsigned int>(std::max(slice, 0.0f)));
+    }
+
+    void setProjection(const glm::mat4& projection, float nearPlane, float farPlane, float width, float height) {
+        block.gridSize[0] = TILES_X;
+        block.gridSize[1] = TILES_Y;
+        block.gridSize[2] = SLICES;
+        block.scale.x = TILES_X / width;
+        block.scale.y = TILES_Y / height;
+        block.scale.z = static_cast<float>(SLICES) / std::log(farPlane / nearPlane);
+        block.scale.w = -block.scale.z * std::log(nearPlane);
+        if (projection == this->projection && nearPlane == this->nearPlane && farPlane == this->farPlane) return;
+
+        this->projection = projection;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        froxels.resize(CLUSTER_COUNT);
+        clusterLights.resize(CLUSTER_COUNT);
+        // a point at view depth d and NDC (x, y) sits at (x d / P00, y d / P11, -d)
+        for (unsigned int z = 0; z < SLICES; z++) {
+            const float d0 = sliceDepth(z), d1 = sliceDepth(z + 1);
+            for (unsigned int y = 0; y < TILES_Y; y++) {
+                const float ny0 = 2.0f * y / TILES_Y - 1.0f, ny1 = 2.0f * (y + 1) / TILES_Y - 1.0f;
+                for (unsigned int x = 0; x < TILES_X; x++) {
+                    const float nx0 = 2.0f * x / TILES_X - 1.0f, nx1 = 2.0f * (x + 1) / TILES_X - 1.0f;
+                    Froxel& froxel = froxels[clusterIndex(x, y, z)];
+                    froxel.min = glm::vec3(FLT_MAX);
+                    froxel.max = glm::vec3(-FLT_MAX);
+                    for (float d : {d0, d1}) {
+                        for (float nx : {nx0, nx1}) {
+                            for (float ny : {ny0, ny1}) {
+                                const glm::vec3 corner(nx * d / projection[0][0], ny * d / projection[1][1], -d);
+                                froxel.min = glm::min(froxel.min, corner);
+                                froxel.max = glm::max(froxel.max, corner);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Conservative slice and tile ranges of every light that is on and in front of the camera.
+    void gatherLights(const glm::mat4& view, const std::vector<LightData>& data) {
+        lights.clear();
+        const float p00 = projection[0][0], p11 = projection[1][1];
+        for (unsigned int i = 0; i < data.size(); i++) {
+            const LightData& light = data[i];
+            const float radius = light.attenuation.w;
+            if (light.position.w == 0.0f || radius <= 0.0f) continue;
+
+            const glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(light.position), 1.0f));
+            const float nearest = -center.z - radius;
+            const float farthest = -center.z + radius;
+            if (farthest < nearPlane || nearest > farPlane) continue;
+
+            LightBounds bounds;
+            bounds.center = center;
+            bounds.radius = radius;
+            bounds.id = i;
+            bounds.z0 = sliceOf(nearest);
+            bounds.z1 = sliceOf(farthest);
+            // x / d is monotonic in d for a fixed x, so the box corners give the projected extremes
+            const float dMin = std::max(nearest, nearPlane), dMax = farthest;
+            const auto ndcRange = [&](float lo, float hi, float scale, unsigned int tiles, unsigned int& first, unsigned int& last) {
+                const float low = std::min(lo * scale / dMin, lo * scale / dMax);
+                const float high = std::max(hi * scale / dMin, hi * scale / dMax);
+                const auto tile = [&](float ndc) {
+                    return static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tiles));
+                };
+                first = static_cast<unsigned int>(std::clamp(tile(low), 0, static_cast<int>(tiles) - 1));
+                last = static_cast<unsigned int>(std::clamp(tile(high), 0, static_cast<int>(tiles) - 1));
+                return high >= -1.0f && low <= 1.0f;
+            };
+            if (!ndcRange(center.x - radius, center.x + radius, p00, TILES_X, bounds.x0, bounds.x1)) continue;
+            if (!ndcRange(center.y - radius, center.y + radius, p11, TILES_Y, bounds.y0, bounds.y1)) continue;
+            lights.push_back(bounds);
+        }
+        lightCount = lights.size();
+    }
+
+    void binSlices(unsigned int zBegin, unsigned int zEnd) {
+        for (unsigned int z = zBegin; z < zEnd; z++) {
+            for (unsigned int i = clusterIndex(0, 0, z); i < clusterIndex(0, 0, z + 1); i++) {
+                clusterLights[i].clear();
+            }
+        }
+        for (const LightBounds& light : lights) {
+            const unsigned int z0 = std::max(light.z0, zBegin);
+            const unsigned int z1 = std::min(light.z1 + 1, zEnd);
+            for (unsigned int z = z0; z < z1; z++) {
+                for (unsigned int y = light.y0; y <= light.y1; y++) {
+                    for (unsigned int x = light.x0; x <= light.x1; x++) {
+                        const unsigned int index = clusterIndex(x, y, z);
+                        const Froxel& froxel = froxels[index];
+                        const glm::vec3 closest = glm::clamp(light.center, froxel.min, froxel.max);
+                        const glm::vec3 offset = closest - light.center;
+                        if (glm::dot(offset, offset) <= light.radius * light.radius) {
+                            clusterLights[index].push_back(light.id);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void flatten() {
+        grid.resize(CLUSTER_COUNT * 2);
+        indices.clear();
+        maxLightsPerCluster = 0;
+        for (unsigned int i = 0; i < CLUSTER_COUNT; i++) {
+            const std::vector<uint32_t>& list = clusterLights[i];
+            grid[i * 2] = static_cast<uint32_t>(indices.size());
+            grid[i * 2 + 1] = static_cast<uint32_t>(list.size());
+            indices.insert(indices.end(), list.begin(), list.end());
+            maxLightsPerCluster = std::max(maxLightsPerCluster, list.size());
+        }
+        indexCount = indices.size();
+    }
+
+    // The lists are rebuilt from scratch every frame. The texture buffers get fresh storage for them,
+    // the block a fresh range.
+    void upload() {
+        if (!gridTexture) return;
+        const size_t offset = uniforms.write(&block, sizeof(ClusterBlock), StreamingBuffer::getUniformAlignment());
+        GLStateCache::get().bindBufferRange(GL_UNIFORM_BUFFER, CLUSTER_UNIFORMS_BINDING, uniforms.getBuffer(), offset, sizeof(ClusterBlock));
+        gridStream.write(grid.data(), grid.size() * sizeof(uint32_t));
+        indexStream.write(indices.data(), indices.size() * sizeof(uint32_t));
+    }
+};
+
+#endif //LIGHTCLUSTERS_H
@@ -0,0 +1,192 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef LIGHTMANAGER_H
+#define LIGHTMANAGER_H
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLStateCache.h"
+#include "Light.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+
+// std140 image of one light, the same for every type. Local lights are stored in a texture buffer
+// as seven RGBA32F texels each, in this order. Keep in sync with struct Light in res/shaders/blinnphong/shader.frag.
+struct LightData {
+    glm::vec4 position;       // xyz, w is 1 when the light is on
+    glm::vec4 direction;      // xyz, w is 1 for spot lights
+    glm::vec4 ambient;        // rgb, a is the intensity
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    glm::vec4 attenuation;    // constant, linear, quadratic, range
+    glm::vec4 cone;           // cosines of the inner and outer cut off
+};
+static_assert(sizeof(LightData) == 7 * 16, "LightData must match the std140 struct");
+
+// The LightUniforms block
+struct LightBlock {
+    int counts[4];            // local (point and spot) lights
+    LightData dirLight;
+};
+static_assert(offsetof(LightBlock, dirLight) == 16, "LightBlock must match the std140 block");
+
+// Keeps every light packed in the layout the shaders read and uploads them once per frame, only when something changed.
+// The directional light lives in the LightUniforms block, point and spot lights in one texture buffer
+// that grows with them, so the light count isn't limited by the uniform block size.
+// Both are streamed: a change rewrites the whole buffer into fresh storage instead of waiting for draws still reading it.
+// All programs read both from fixed binding points, the cost doesn't grow with the number of shaders.
+class LightManager {
+public:
+    // a light's reach ends where it adds less than this to a channel
+    static constexpr float CUTOFF = 1.0f / 256.0f;
+
+    // bytes written by the last upload(), for the inspector
+    size_t uploadedBytes = 0;
+
+    static LightManager& get() {
+        static LightManager manager;
+        return manager;
+    }
+
+    void create() {
+        blockStream.create(GL_UNIFORM_BUFFER, sizeof(LightBlock), StreamingBuffer::ORPHAN);
+        GLStateCache::get().bindBufferBase(GL_UNIFORM_BUFFER, LIGHT_UNIFORMS_BINDING, blockStream.getBuffer());
+        blockDirty = true;
+
+        lightStream.create(GL_TEXTURE_BUFFER, 64 * sizeof(LightData), StreamingBuffer::ORPHAN);
+        GLStateCache::get().bindBuffer(GL_TEXTURE_BUFFER, 0);
+        glGenTextures(1, &lightTexture);
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_BUFFER, lightTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightStream.getBuffer());
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_BUFFER, 0);
+        localDirty = true;
+    }
+
+    void add(Light* light) {
+        if (light->type == DIRECTIONAL) {
+            dirLight = light;
+        } else {
+            if (std::find(localLights.begin(), localLights.end(), light) != localLights.end()) return;
+            light->id = static_cast<int>(localLights.size());
+            localLights.push_back(light);
+            localData.emplace_back();
+            blockDirty = true;
+        }
+        light->dirty = true;
+    }
+
+    // The last local light moves into the freed slot.
+    void remove(Light* light) {
+        if (light->type == DIRECTIONAL) {
+            if (dirLight == light) {
+                dirLight = nullptr;
+                block.dirLight = LightData{};
+                blockDirty = true;
+            }
+            return;
+        }
+        auto it = std::find(localLights.begin(), localLights.end(), light);
+        if (it == localLights.end()) return;
+        const size_t index = it - localLights.begin();
+        localLights[index] = localLights.back();
+        localData[index] = localData.back();
+        localLights.pop_back();
+        localData.pop_back();
+        localDirty = true;
+        if (index < localLights.size()) {
+            localLights[index]->id = static_cast<int>(index);
+            localLights[index]->dirty = true;
+        }
+        blockDirty = true;
+    }
+
+    size_t size() const {
+        return (dirLight ? 1 : 0) + localLights.size();
+    }
+
+    // point and spot lights, a light's id is its index here and in the texture buffer
+    const std::vector<Light*>& getLocalLights() const {
+        return localLights;
+    }
+
+    // packed like the texture buffer, current after upload()
+    const std::vector<LightData>& getLocalData() const {
+        return localData;
+    }
+
+    unsigned int getLightTexture() const {
+        return lightTexture;
+    }
+
+    // Distance where the attenuated light falls under CUTOFF.
+    static float rangeOf(const Light& light) {
+        const glm::vec3 color = glm::max(light.diffuse, glm::max(light.specular, light.ambient));
+        const float brightest = std::max(color.x, std::max(color.y, color.z)) * light.intensity;
+        // constant + linear d + quadratic d^2 = brightest / CUTOFF
+        const float c = light.constant - brightest / CUTOFF;
+        if (c >= 0.0f) return 0.0f;
+        if (light.quadratic <= 0.0f) return light.linear > 0.0f ? -c / light.linear : FLT_MAX;
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+    }
+
+    // Packs the dirty lights and streams the block and the light buffer if anything in them changed.
+    void upload() {
+        uploadedBytes = 0;
+        if (dirLight && dirLight->dirty) {
+            pack(*dirLight, block.dirLight);
+            blockDirty = true;
+        }
+        for (size_t i = 0; i < localLights.size(); i++) {
+            if (!localLights[i]->dirty) continue;
+            pack(*localLights[i], localData[i]);
+            localDirty = true;
+        }
+        if (!lightTexture) return;
+
+        if (blockDirty) {
+            block.counts[0] = static_cast<int>(localLights.size());
+            blockStream.write(&block, sizeof(LightBlock));
+            uploadedBytes += sizeof(LightBlock);
+            blockDirty = false;
+        }
+        if (localDirty) {
+            lightStream.write(localData.data(), localData.size() * sizeof(LightData));
+            uploadedBytes += localData.size() * sizeof(LightData);
+            localDirty = false;
+        }
+    }
+
+private:
+    LightBlock block{};
+    Light* dirLight = nullptr;
+    std::vector<Light*> localLights;
+    std::vector<LightData> localData;
+    bool blockDirty = true;
+    bool localDirty = true;
+
+    StreamingBuffer blockStream;
+    StreamingBuffer lightStream;
+    unsigned int lightTexture = 0;
+
+    LightManager() = default;
+
+    void pack(Light& light, LightData& out) {
+        out.position = glm::vec4(light.position, light.active ? 1.0f : 0.0f);
+        out.direction = glm::vec4(light.direction, light.type == SPOTLIGHT ? 1.0f : 0.0f);
+        out.ambient = glm::vec4(light.ambient, light.intensity);
+        out.diffuse = glm::vec4(light.diffuse, 0.0f);
+        out.specular = glm::vec4(light.specular, 0.0f);
+        out.attenuation = glm::vec4(light.constant, light.linear, light.quadratic, rangeOf(light));
+        out.cone = glm::vec4(light.cutOff, light.outerCutOff, 0.0f, 0.0f);
+        light.dirty = false;
+    }
+};
+
+#endif //LIGHTMANAGER_H
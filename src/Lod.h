@@ -0,0 +1,50 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef LOD_H
+#define LOD_H
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Model.h"
+
+// Picks a model's LOD from the screen space size of its simplification error.
+// A level is allowed while its error covers at most maxPixelError pixels. Switching to a coarser
+// level additionally needs a margin of hysteresis, so objects sitting at a threshold distance don't flicker.
+struct LodSettings {
+    bool enabled = true;
+    float maxPixelError = 1.0f;
+    float hysteresis = 0.25f;
+    float projectionScale = 1.0f;    // pixels covered by one unit at distance one
+
+    void setProjection(float fovYDegrees, float viewportHeight) {
+        projectionScale = viewportHeight / (2.0f * std::tan(glm::radians(fovYDegrees) * 0.5f));
+    }
+
+    // scale: largest axis scale of the world matrix, distance: from the camera to the bounding sphere
+    int select(const Model& model, float scale, float distance, int current) const {
+        return select(model.lodErrors, scale, distance, current);
+    }
+
+    // same for anything drawn at one level from several models, lodErrors holds the worst error of each level
+    int select(const std::vector<float>& lodErrors, float scale, float distance, int current) const {
+        const int count = static_cast<int>(lodErrors.size());
+        if (!enabled || count <= 1) return 0;
+
+        const float pixelsPerUnit = scale * projectionScale / std::max(distance, 0.001f);
+        int lod = std::clamp(current, 0, count - 1);
+        while (lod > 0 && lodErrors[lod] * pixelsPerUnit > maxPixelError) lod--;
+        while (lod + 1 < count && lodErrors[lod + 1] * pixelsPerUnit <= maxPixelError * (1.0f - hysteresis)) lod++;
+        return lod;
+    }
+
+    // distance from the camera to the surface of a world space bounding sphere, zero inside it
+    static float sphereDistance(const glm::vec3& cameraPosition, const glm::vec3& center, float radius) {
+        return std::max(glm::length(center - cameraPosition) - radius, 0.0f);
+    }
+};
+
+#endif //LOD_H
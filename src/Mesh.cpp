@@ -4,108 +4,167 @@
 
 #include "Mesh.h"
 
+#include <algorithm>
+#include <map>
+
+#include "GeometryPool.h"
+#include "GLStateCache.h"
+#include "MeshSimplifier.h"
+
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
     this->vertices = vertices;
     this->indices = indices;
     this->textures = textures;
+    textureSet = internTextureSet(textures);
 
+    computeBounds();
+    generateLods();
     setupMesh();
 }
 
-void Mesh::setupMesh() {
-    // create buffers/arrays
+Mesh::Mesh(std::vector<Texture> textures) {
+    this->textures = textures;
+    textureSet = internTextureSet(textures);
+    VAO = VBO = EBO = 0;
+    lods.push_back({0, 0, 0.0f});
+}
+
+// Replaces the whole contents, orphaning the old storage.
+void Mesh::upload(std::vector<Vertex> vertices, std::vector<unsigned int> indices) {
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    lods.assign(1, {0, static_cast<unsigned int>(this->indices.size()), 0.0f});
+    computeBounds();
+
+    const VertexFormat::Format format = VertexFormat::choose(this->vertices);
+    if (!VAO) {
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
+        GeometryPool::describeVertex(VAO, VBO, EBO, format);
+    } else if (format != vertexFormat) {
+        GeometryPool::describeVertex(VAO, VBO, EBO, format);
+    }
+    vertexFormat = format;
+    std::vector<unsigned char> packed;
+    VertexFormat::pack(format, this->vertices, packed);
+    GLStateCache& state = GLStateCache::get();
+    state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_DYNAMIC_DRAW);
+    state.bindVertexArray(VAO);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(unsigned int), this->indices.data(), GL_DYNAMIC_DRAW);
+    state.bindVertexArray(0);
+}
+
+void Mesh::computeBounds() {
+    bounds = AABB();
+    for (const Vertex& vertex : vertices) {
+        bounds.expand(vertex.position);
+    }
+
+    // centred on the box, radius reaches the farthest vertex
+    sphere.center = bounds.isValid() ? bounds.getCenter() : glm::vec3(0.0f);
+    float radiusSquared = 0.0f;
+    for (const Vertex& vertex : vertices) {
+        glm::vec3 d = vertex.position - sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+    }
+    sphere.radius = std::sqrt(radiusSquared);
+}
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, biTangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+// Each level targets half the triangles of the previous one, all taken from one simplifier pass.
+// Stops early once the simplifier stalls on locked borders and seams.
+void Mesh::generateLods() {
+    lods.clear();
+    lodIndices.clear();
+    lods.push_back({0, static_cast<unsigned int>(indices.size()), 0.0f});
+    if (indices.size() / 3 < MIN_LOD_TRIANGLES) return;
+
+    MeshSimplifier simplifier(vertices, indices);
+    size_t target = indices.size();
+    while (lods.size() < MAX_LODS) {
+        target = (target / 6) * 3;
+        std::vector<unsigned int> simplified = simplifier.simplify(target);
+        if (simplified.empty() || simplified.size() > lods.back().indexCount * 85 / 100) break;
+
+        lods.push_back({static_cast<unsigned int>(indices.size() + lodIndices.size()), static_cast<unsigned int>(simplified.size()), simplifier.getError()});
+        lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+    }
 }
 
-void Mesh::Draw(Shader *shader, unsigned int skyboxTexture = NULL) {
+const MeshLod& Mesh::getLod(int lod) const {
+    return lods[std::clamp(lod, 0, static_cast<int>(lods.size()) - 1)];
+}
+
+const unsigned int* Mesh::getLodIndices(int lod) const {
+    const MeshLod& range = getLod(lod);
+    if (range.indexOffset < indices.size()) return indices.data() + range.indexOffset;
+    return lodIndices.data() + (range.indexOffset - indices.size());
+}
+
+// Copies the vertices, in the smallest format that keeps what they carry, and every level's indices
+// into the shared GeometryPool.
+void Mesh::setupMesh() {
+    vertexFormat = VertexFormat::choose(vertices);
+    GeometryRange range = GeometryPool::get().allocate(vertices, indices, lodIndices, vertexFormat);
+    const GeometryBlock& block = GeometryPool::get().getBlock(range.block);
+    VAO = block.VAO;
+    VBO = block.VBO;
+    EBO = block.EBO;
+    geometryBlock = range.block;
+    baseVertex = range.baseVertex;
+    firstIndex = range.firstIndex;
+}
+
+void Mesh::Draw(Shader *shader, unsigned int skyboxTexture = NULL, int lod) {
     shader->use();
     // std::cout << "Mesh Draw - isTorus: " << isTorus
     //           << ", vertices: " << vertices.size()
     //           << ", indices: " << indices.size() << std::endl;
 
-    // bind appropriate textures
-    unsigned int diffuseNr  = 1;
-    unsigned int specularNr = 1;
-    unsigned int normalNr   = 1;
-    unsigned int heightNr   = 1;
+    bindTextures(skyboxTexture);
+
+    // draw mesh, the bindings stay for the next draw, GLStateCache drops them if it needs the same
+    GLStateCache::get().bindVertexArray(VAO);
+    drawElements(lod);
+}
+
+// Texture units follow the order of the textures vector, the shaders sample them by unit.
+void Mesh::bindTextures(unsigned int skyboxTexture) const {
+    GLStateCache& state = GLStateCache::get();
     if(skyboxTexture) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+        state.bindTexture(0, GL_TEXTURE_CUBE_MAP, skyboxTexture);
     }
     for(unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        std::string number;
-        std::string name = textures[i].type;
-        if(name == "texture_diffuse") {
-            number = std::to_string(diffuseNr++);
-            // shader.setInt("material.diffuse", textures[i].id);
-        }
-        else if(name == "texture_specular") {
-            number = std::to_string(specularNr++); // transfer unsigned int to string
-            // shader.setInt("material.specular", textures[i].id);
-        }
-        else if(name == "texture_normal")
-            number = std::to_string(normalNr++); // transfer unsigned int to string
-        else if(name == "texture_height")
-            number = std::to_string(heightNr++); // transfer unsigned int to string
-
-        // now set the sampler to the correct texture unit
-        // glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-
-        // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
-
+        state.bindTexture(static_cast<int>(i), GL_TEXTURE_2D, textures[i].id);
     }
+}
 
-    // draw mesh
-    glBindVertexArray(VAO);
-
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+// expects the VAO to be bound
+void Mesh::drawElements(int lod) const {
+    const MeshLod& range = getLod(lod);
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                             (void*)((firstIndex + range.indexOffset) * sizeof(unsigned int)), baseVertex);
+}
 
-    glBindVertexArray(0);
+void Mesh::drawElementsInstanced(int lod, size_t instanceCount) const {
+    const MeshLod& range = getLod(lod);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                                      (void*)((firstIndex + range.indexOffset) * sizeof(unsigned int)),
+                                      static_cast<GLsizei>(instanceCount), baseVertex);
+}
 
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+// Meshes with the same textures in the same order share an id, so draws can be grouped by it.
+unsigned int Mesh::internTextureSet(const std::vector<Texture>& textures) {
+    static std::map<std::vector<unsigned int>, unsigned int> sets;
+    std::vector<unsigned int> ids;
+    ids.reserve(textures.size());
+    for (const Texture& texture : textures) {
+        ids.push_back(texture.id);
+    }
+    return sets.emplace(ids, static_cast<unsigned int>(sets.size())).first->second;
 }
 
 
@@ -9,30 +9,22 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
+#include "Bounds.h"
 #include "Shader.h"
+#include "VertexFormat.h"
 #include "imgui_impl/imgui_impl_opengl3_loader.h"
 
-#define MAX_BONE_INFLUENCE 4
-
-
 enum Material {
     STANDARD,
     REFLECTIVE,
     REFRACTIVE,
 };
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texCoords;
-    //tangent
-    glm::vec3 tangent;
-    // bitangent
-    glm::vec3 biTangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
+// A contiguous range of the element buffer. Level 0 is the full mesh, later levels are simplified.
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;    // MeshSimplifier::getError() when the level was taken, an object space distance
 };
 
 struct Texture {
@@ -49,15 +41,58 @@ class Mesh {
 
     Material material = STANDARD;
 
+    static constexpr int MAX_LODS = 4;
+    // meshes with fewer triangles are not worth simplifying
+    static constexpr size_t MIN_LOD_TRIANGLES = 64;
+
+    // index lists of the simplified levels, stored after indices in the element buffer
+    std::vector<unsigned int> lodIndices;
+    std::vector<MeshLod> lods;
+
     bool instanced = false;
 
+    // buffers of the GeometryPool block holding this mesh, the vertex array is shared with the block's other meshes
     unsigned int VAO, VBO, EBO;
+    int geometryBlock = -1;
+    // layout of the vertices on the GPU, the block holds only meshes of this format
+    VertexFormat::Format vertexFormat = VertexFormat::FULL;
+    // where the mesh starts in the block, added to every draw
+    int baseVertex = 0;
+    unsigned int firstIndex = 0;
+
+    // equal for meshes binding the same textures
+    unsigned int textureSet = 0;
+
+    // object space, computed from the vertices on construction
+    AABB bounds;
+    BoundingSphere sphere;
 
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void Draw(Shader *shader, unsigned int skyboxTexture);
+    // Empty mesh with buffers of its own instead of a GeometryPool range, for geometry rebuilt at runtime
+    // (see StaticBatcher). upload() fills it, it has no simplified levels.
+    explicit Mesh(std::vector<Texture> textures);
+    void upload(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
+    void Draw(Shader *shader, unsigned int skyboxTexture, int lod = 0);
+
+    void bindTextures(unsigned int skyboxTexture) const;
+
+    void drawElements(int lod) const;
+
+    void drawElementsInstanced(int lod, size_t instanceCount) const;
+
+    static unsigned int internTextureSet(const std::vector<Texture>& textures);
 
     void setupMesh();
 
+    void computeBounds();
+
+    void generateLods();
+
+    const MeshLod& getLod(int lod) const;
+
+    // CPU copy of a level's index list
+    const unsigned int* getLodIndices(int lod) const;
+
     unsigned int getVAO();
 };
 
@@ -12,6 +12,7 @@
 #include "assimp/scene.h"
 #include "glad/glad.h"
 #include "imgui_impl/imgui_impl_opengl3_loader.h"
+#include "GLStateCache.h"
 #include "Shader.h"
 #include "assimp/scene.h"
 #include "stb_image.h"
@@ -47,15 +48,16 @@ class Mesh1 {
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLStateCache& state = GLStateCache::get();
+        state.bindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        state.bindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex1), &vertices[0], GL_STATIC_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
@@ -81,7 +83,7 @@ class Mesh1 {
         // weights
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex1), (void*)offsetof(Vertex1, m_Weights));
-        glBindVertexArray(0);
+        state.bindVertexArray(0);
     }
     unsigned int getVAO() {
         return this->VAO;
@@ -129,22 +131,17 @@ public:
                 number = std::to_string(heightNr++); // transfer unsigned int to string
 
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader->ID, (name + number).c_str()), i);
+            shader->setInt(name + number, i);
 
             // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            GLStateCache::get().bindTexture(static_cast<int>(i), GL_TEXTURE_2D, textures[i].id);
 
         }
 
         // draw mesh
-        glBindVertexArray(VAO);
+        GLStateCache::get().bindVertexArray(VAO);
 
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 };
 
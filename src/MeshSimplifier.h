@@ -0,0 +1,345 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+
+// Quadric error metric edge collapse (Garland & Heckbert) that only rewrites the index list.
+// Positions collapse onto a neighbouring position instead of a new optimal point, so every LOD
+// shares the mesh's vertex buffer. Vertices with the same position but different normals or UVs
+// move together, and only onto a position whose vertices they already share a triangle with,
+// so hard edges and texture seams survive. Open borders are never moved.
+// Collapses happen in order of increasing cost, so simplifying further continues where the previous
+// target stopped: call simplify() with decreasing targets to take every LOD from a single pass.
+// The quadric cost only orders the collapses. The reported error is measured separately as a distance.
+class MeshSimplifier {
+public:
+    MeshSimplifier(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+        : vertices(vertices), triangles(indices.begin(), indices.end() - indices.size() % 3) {
+        setup();
+    }
+
+    // Collapses until at most targetIndexCount indices remain, or as close as the constraints allow.
+    std::vector<unsigned int> simplify(size_t targetIndexCount) {
+        run(targetIndexCount / 3);
+        return result();
+    }
+
+    // Largest distance so far from a removed position to the nearest plane of the triangles that replaced it,
+    // in object space units. The planes are unbounded, so this can underestimate where a fan is narrow.
+    float getError() const {
+        return maxError;
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    // symmetric 4x4 matrix of a sum of squared plane distances
+    struct Quadric {
+        double a[10] = {};
+
+        void addPlane(double x, double y, double z, double w) {
+            a[0] += x * x; a[1] += x * y; a[2] += x * z; a[3] += x * w;
+            a[4] += y * y; a[5] += y * z; a[6] += y * w;
+            a[7] += z * z; a[8] += z * w;
+            a[9] += w * w;
+        }
+
+        void add(const Quadric& other) {
+            for (int i = 0; i < 10; i++) a[i] += other.a[i];
+        }
+
+        double evaluate(const glm::vec3& v) const {
+            const double x = v.x, y = v.y, z = v.z;
+            return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                 + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                 + a[7] * z * z + 2 * a[8] * z
+                 + a[9];
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        uint32_t from;           // positions
+        uint32_t to;
+        uint32_t fromVersion;    // versions when queued, stale entries are skipped
+        uint32_t toVersion;
+
+        bool operator>(const Collapse& other) const {
+            return cost > other.cost;
+        }
+    };
+
+    const std::vector<Vertex>& vertices;
+    std::vector<uint32_t> triangles;              // three vertex indices per triangle, rewritten as positions collapse
+    std::vector<uint8_t> removed;                 // per triangle
+    std::vector<uint32_t> position;               // vertex -> welded position
+    std::vector<glm::vec3> points;                // per position
+    std::vector<Quadric> quadrics;                // per position
+    std::vector<std::vector<uint32_t>> positionTriangles;
+    std::vector<uint8_t> locked;                  // per position, set on open borders
+    std::vector<uint8_t> collapsed;               // per position
+    std::vector<uint32_t> versions;               // per position
+    std::vector<std::vector<uint32_t>> merged;    // per position, positions that collapsed into it
+    std::vector<uint32_t> wedgeMap;               // scratch, vertex -> vertex it moves onto
+    std::vector<uint32_t> movedWedges;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> queue;
+    size_t liveTriangles = 0;
+    float maxError = 0.0f;
+
+    void setup() {
+        const size_t triangleCount = triangles.size() / 3;
+        removed.assign(triangleCount, 0);
+        liveTriangles = triangleCount;
+        wedgeMap.assign(vertices.size(), NONE);
+
+        weldPositions();
+        positionTriangles.resize(points.size());
+        quadrics.resize(points.size());
+        locked.assign(points.size(), 0);
+        collapsed.assign(points.size(), 0);
+        versions.assign(points.size(), 0);
+        merged.resize(points.size());
+
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            const uint32_t* tri = &triangles[t * 3];
+            for (int k = 0; k < 3; k++) positionTriangles[position[tri[k]]].push_back(t);
+
+            const glm::vec3& p0 = points[position[tri[0]]];
+            glm::vec3 n = glm::cross(points[position[tri[1]]] - p0, points[position[tri[2]]] - p0);
+            const float length = glm::length(n);
+            if (length == 0.0f) continue;
+            n /= length;
+            const float d = -glm::dot(n, p0);
+            for (int k = 0; k < 3; k++) quadrics[position[tri[k]]].addPlane(n.x, n.y, n.z, d);
+        }
+
+        lockBorders();
+        for (uint32_t p = 0; p < points.size(); p++) queueEdgesOf(p);
+    }
+
+    void weldPositions() {
+        std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+        position.resize(vertices.size());
+        for (uint32_t v = 0; v < vertices.size(); v++) {
+            const glm::vec3& p = vertices[v].position;
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            const uint64_t hash = (uint64_t(bits[0]) * 73856093u) ^ (uint64_t(bits[1]) * 19349663u) ^ (uint64_t(bits[2]) * 83492791u);
+
+            std::vector<uint32_t>& bucket = buckets[hash];
+            uint32_t found = NONE;
+            for (uint32_t candidate : bucket) {
+                if (points[candidate] == p) {
+                    found = candidate;
+                    break;
+                }
+            }
+            if (found == NONE) {
+                found = static_cast<uint32_t>(points.size());
+                points.push_back(p);
+                bucket.push_back(found);
+            }
+            position[v] = found;
+        }
+    }
+
+    // edges used by one triangle, compared by position, are open borders
+    void lockBorders() {
+        std::unordered_map<uint64_t, int> edgeUse;
+        auto key = [&](uint32_t a, uint32_t b) {
+            uint32_t pa = position[a], pb = position[b];
+            if (pa > pb) std::swap(pa, pb);
+            return (uint64_t(pa) << 32) | pb;
+        };
+        for (size_t t = 0; t < removed.size(); t++) {
+            for (int k = 0; k < 3; k++) edgeUse[key(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3])]++;
+        }
+        for (size_t t = 0; t < removed.size(); t++) {
+            for (int k = 0; k < 3; k++) {
+                const uint32_t a = triangles[t * 3 + k], b = triangles[t * 3 + (k + 1) % 3];
+                if (edgeUse[key(a, b)] != 2) {
+                    locked[position[a]] = 1;
+                    locked[position[b]] = 1;
+                }
+            }
+        }
+    }
+
+    void queueEdgesOf(uint32_t from) {
+        if (locked[from] || collapsed[from]) return;
+        for (uint32_t t : positionTriangles[from]) {
+            if (removed[t]) continue;
+            for (int k = 0; k < 3; k++) {
+                const uint32_t to = position[triangles[t * 3 + k]];
+                if (to != from) queueEdge(from, to);
+            }
+        }
+    }
+
+    void queueEdge(uint32_t from, uint32_t to) {
+        if (locked[from]) return;
+        Quadric q = quadrics[from];
+        q.add(quadrics[to]);
+        queue.push({std::max(0.0, q.evaluate(points[to])), from, to, versions[from], versions[to]});
+    }
+
+    // Finds for every vertex at from the vertex at to it shares a triangle with.
+    // Fails when a vertex has no such partner, i.e. the move would cross a seam or hard edge.
+    bool mapWedges(uint32_t from, uint32_t to) {
+        bool ok = true;
+        for (uint32_t t : positionTriangles[from]) {
+            if (removed[t]) continue;
+            const uint32_t* tri = &triangles[t * 3];
+            uint32_t wedge = NONE, partner = NONE;
+            for (int k = 0; k < 3; k++) {
+                if (position[tri[k]] == from) wedge = tri[k];
+                if (position[tri[k]] == to) partner = tri[k];
+            }
+            if (partner != NONE) wedgeMap[wedge] = partner;
+        }
+        for (uint32_t t : positionTriangles[from]) {
+            if (removed[t]) continue;
+            for (int k = 0; k < 3; k++) {
+                const uint32_t v = triangles[t * 3 + k];
+                if (position[v] == from && wedgeMap[v] == NONE) ok = false;
+            }
+        }
+        return ok;
+    }
+
+    void clearWedges(uint32_t from) {
+        for (uint32_t t : positionTriangles[from]) {
+            for (int k = 0; k < 3; k++) {
+                const uint32_t v = triangles[t * 3 + k];
+                if (position[v] == from) wedgeMap[v] = NONE;
+            }
+        }
+    }
+
+    // moving from onto to must not turn any of the remaining triangles over
+    bool flips(uint32_t from, uint32_t to) const {
+        for (uint32_t t : positionTriangles[from]) {
+            if (removed[t]) continue;
+            const uint32_t* tri = &triangles[t * 3];
+            glm::vec3 p[3], q[3];
+            bool touchesTarget = false;
+            for (int k = 0; k < 3; k++) {
+                const uint32_t pos = position[tri[k]];
+                touchesTarget |= pos == to;
+                p[k] = points[pos];
+                q[k] = pos == from ? points[to] : p[k];
+            }
+            if (touchesTarget) continue;
+
+            const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            const glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.0f) return true;
+        }
+        return false;
+    }
+
+    void run(size_t targetTriangles) {
+        while (liveTriangles > targetTriangles && !queue.empty()) {
+            const Collapse collapse = queue.top();
+            queue.pop();
+            const uint32_t from = collapse.from;
+            const uint32_t to = collapse.to;
+            if (collapse.fromVersion != versions[from] || collapse.toVersion != versions[to] || collapsed[from] || collapsed[to]) continue;
+            if (flips(from, to)) continue;
+            if (!mapWedges(from, to)) {
+                clearWedges(from);
+                continue;
+            }
+            collapseEdge(from, to);
+            maxError = std::max(maxError, deviation(to));
+        }
+    }
+
+    void collapseEdge(uint32_t from, uint32_t to) {
+        collapsed[from] = 1;
+        quadrics[to].add(quadrics[from]);
+        merged[to].push_back(from);
+        merged[to].insert(merged[to].end(), merged[from].begin(), merged[from].end());
+        std::vector<uint32_t>().swap(merged[from]);
+        movedWedges.clear();
+
+        for (uint32_t t : positionTriangles[from]) {
+            if (removed[t]) continue;
+            uint32_t* tri = &triangles[t * 3];
+            bool degenerate = false;
+            for (int k = 0; k < 3; k++) {
+                if (position[tri[k]] == to) degenerate = true;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (position[tri[k]] != from) continue;
+                movedWedges.push_back(tri[k]);
+                tri[k] = wedgeMap[tri[k]];
+            }
+            if (degenerate) {
+                removed[t] = 1;
+                liveTriangles--;
+            } else {
+                positionTriangles[to].push_back(t);
+            }
+        }
+        for (uint32_t v : movedWedges) {
+            wedgeMap[v] = NONE;
+        }
+        positionTriangles[from].clear();
+        std::vector<uint32_t>& around = positionTriangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return removed[t] != 0; }), around.end());
+
+        // only edges touching the merged position changed cost
+        versions[from]++;
+        versions[to]++;
+        queueEdgesOf(to);
+        for (uint32_t t : around) {
+            for (int k = 0; k < 3; k++) {
+                const uint32_t neighbour = position[triangles[t * 3 + k]];
+                if (neighbour != to) queueEdge(neighbour, to);
+            }
+        }
+    }
+
+    // the removed positions now covered by the fan around to, each measured against the closest fan plane
+    float deviation(uint32_t to) const {
+        float worst = 0.0f;
+        for (uint32_t p : merged[to]) {
+            float nearest = -1.0f;
+            for (uint32_t t : positionTriangles[to]) {
+                const uint32_t* tri = &triangles[t * 3];
+                const glm::vec3& p0 = points[position[tri[0]]];
+                glm::vec3 n = glm::cross(points[position[tri[1]]] - p0, points[position[tri[2]]] - p0);
+                const float length = glm::length(n);
+                if (length == 0.0f) continue;
+                const float distance = std::abs(glm::dot(n / length, points[p] - p0));
+                if (nearest < 0.0f || distance < nearest) nearest = distance;
+            }
+            worst = std::max(worst, nearest);
+        }
+        return worst;
+    }
+
+    std::vector<unsigned int> result() const {
+        std::vector<unsigned int> out;
+        out.reserve(liveTriangles * 3);
+        for (size_t t = 0; t < removed.size(); t++) {
+            if (removed[t]) continue;
+            out.insert(out.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+        }
+        return out;
+    }
+};
+
+#endif //MESHSIMPLIFIER_H
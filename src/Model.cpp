@@ -4,35 +4,88 @@
 
 #include "Model.h"
 
+#include <algorithm>
+
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include <stb_image.h>
 
+#include "GLStateCache.h"
+
 Model::Model(std::string path) {
     loadModel(path);
+    computeBounds();
+    computeLodErrors();
 }
 
 Model::Model(Mesh mesh) {
     meshes.push_back(mesh);
+    computeBounds();
+    computeLodErrors();
 }
 
 
-void Model::Draw(Shader *shader, unsigned int skyboxTexture = NULL) {
+void Model::Draw(Shader *shader, unsigned int skyboxTexture = NULL, int lod) {
     for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(shader, skyboxTexture);
+        meshes[i].Draw(shader, skyboxTexture, lod);
     }
 }
 
 void Model::addMesh(Mesh mesh) {
     meshes.push_back(mesh);
+    computeBounds();
+    computeLodErrors();
+}
+
+// Meshes with fewer levels keep drawing their last one, so its error carries over.
+void Model::computeLodErrors() {
+    size_t count = 0;
+    for (const Mesh& mesh : meshes) {
+        count = std::max(count, mesh.lods.size());
+    }
+    lodErrors.assign(count, 0.0f);
+    for (const Mesh& mesh : meshes) {
+        for (size_t lod = 0; lod < count; lod++) {
+            lodErrors[lod] = std::max(lodErrors[lod], mesh.getLod(static_cast<int>(lod)).error);
+        }
+    }
+}
+
+int Model::getLodCount() const {
+    return static_cast<int>(lodErrors.size());
+}
+
+size_t Model::getTriangleCount(int lod) const {
+    size_t triangles = 0;
+    for (const Mesh& mesh : meshes) {
+        triangles += mesh.getLod(lod).indexCount / 3;
+    }
+    return triangles;
+}
+
+void Model::computeBounds() {
+    bounds = AABB();
+    for (const Mesh& mesh : meshes) {
+        bounds.expand(mesh.bounds);
+    }
+
+    sphere.center = bounds.isValid() ? bounds.getCenter() : glm::vec3(0.0f);
+    sphere.radius = 0.0f;
+    for (const Mesh& mesh : meshes) {
+        if (!mesh.bounds.isValid()) continue;
+        sphere.radius = std::max(sphere.radius, glm::length(mesh.sphere.center - sphere.center) + mesh.sphere.radius);
+    }
 }
 
 
 void Model::loadModel(std::string path) {
     Assimp::Importer import;
-    const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    // Without joining, the OBJ importer gives every face corner its own vertex, so no two triangles share an index.
+    // The simplifier would see every edge as a seam, and the vertex buffers would be about three times larger.
+    // Only exact duplicates (position, normal, UV, tangents, bones) are merged, so rendering stays the same.
+    const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
 
     if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
@@ -200,7 +253,7 @@ unsigned int Model::TextureFromFile(const char *path, const std::string &directo
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -16,12 +16,27 @@ public:
     Model(std::string path);
     Model(Mesh mesh);
 
-    void Draw(Shader *shader, unsigned int skyboxTexure);
+    void Draw(Shader *shader, unsigned int skyboxTexure, int lod = 0);
 
     void addMesh(Mesh mesh);
     std::vector<Texture> textureLoaded;
     std::vector<Mesh> meshes;
 
+    // object space bounds of all meshes together
+    AABB bounds;
+    BoundingSphere sphere;
+
+    void computeBounds();
+
+    // per level, the largest error of any mesh at that level
+    std::vector<float> lodErrors;
+
+    void computeLodErrors();
+
+    int getLodCount() const;
+
+    size_t getTriangleCount(int lod) const;
+
 
 private:
 
@@ -4,22 +4,33 @@
 
 #ifndef NODE_H
 #define NODE_H
+#include <algorithm>
 #include <list>
 #include <memory>
 #include <random>
 #include <glm/ext/matrix_transform.hpp>
+#include <tuple>
 #include <vector>
 
+#include "EntityRegistry.h"
+#include "GLStateCache.h"
 #include "Instance.h"
 #include "Light.h"
+#include "LightManager.h"
+#include "NodeRegistry.h"
+#include "PrefabInstancer.h"
+#include "SlabArena.h"
 #include "Transform.h"
+#include "Util.h"
 
 
 
+// Thin facade over one entity: the hierarchy and label live here, everything a system iterates over
+// (model, light, instance, spin) is a component in the EntityRegistry.
 class Node {
 
-    bool stationary = true;
-    std::string label = "Node";
+    NodeRegistry::NodeId id;
+    NodeRegistry::LabelId labelId;
 
 public:
 
@@ -30,44 +41,97 @@ public:
 
     Transform transform;
 
-    Model* model = nullptr;
-    Instance* instance = nullptr;
-
+    // change it through setVisible(), so caches of what is drawn notice
     bool visible = true;
 
     bool* wireframe = nullptr;
 
-    Light* light = nullptr;
-
-    Material material = STANDARD;
-
-    std::vector<std::string> materialMap = {
+    static inline const std::vector<std::string> materialMap = {
         "Standard",
         "Reflective",
         "Refractive"
     };
 
+    // local TRS handed to spawnBatch() for each copy
+    struct SpawnTransform {
+        glm::vec3 position{0.0f};
+        glm::vec3 eulerRotation{0.0f};
+        glm::vec3 scale{1.0f};
+    };
+
+    // Nodes live in slabs, make_unique<Node> and new Node go through the arena
+    static void* operator new(size_t size) {
+        if (size != sizeof(Node)) return ::operator new(size);
+        return arena().allocate();
+    }
 
-    Node(Model* model = nullptr, const Transform& transform = Transform())
-    : parent(nullptr), transform(transform) {
+    static void operator delete(void* p, size_t size) {
+        if (size != sizeof(Node)) {
+            ::operator delete(p);
+            return;
+        }
+        arena().deallocate(p);
+    }
+
+    static SlabArena& arena() {
+        static SlabArena nodeArena(sizeof(Node), alignof(Node));
+        return nodeArena;
+    }
+
+
+    Node(Model* model = nullptr)
+    : parent(nullptr) {
+        NodeRegistry& registry = NodeRegistry::get();
+        static const NodeRegistry::LabelId defaultLabel = registry.intern("Node");
+        labelId = defaultLabel;
+        id = registry.add(this, labelId);
+
+        EntityRegistry::get().add<TransformComponent>(id, {transform.getHandle()});
         if (model != nullptr) {
-            this->model = model;
+            setModel(model);
         }
-        children = std::vector<std::unique_ptr<Node>>();
+        TransformStore::get().setOwner(transform.getHandle(), this);
         // children = std::vector<Node*>();
-        setRandomRotationSpeed();
     }
 
+    Node(Model* model, const Transform& transform)
+    : Node(model) {
+        this->transform = transform;
+    }
+
+    ~Node() {
+        if (Light* light = getLight()) LightManager::get().remove(light);
+        EntityRegistry::get().destroy(id);
+        NodeRegistry::get().remove(id);
+    }
+
+    // bumped whenever a node is shown or hidden, for caches of what is drawn such as the StaticBatcher
+    static inline uint32_t visibilityVersion = 0;
+
     void toggleVisibility() {
-        visible = !visible;
+        setVisible(!visible);
     }
 
     void setVisible(bool v) {
+        if (visible == v) return;
         visible = v;
+        visibilityVersion++;
     }
 
+    // The light joins the LightManager's block, its position follows this node.
     void setLight(Light* l) {
-        light = l;
+        if (Light* previous = getLight()) LightManager::get().remove(previous);
+        if (l) {
+            EntityRegistry::get().add<LightComponent>(id, {l});
+            LightManager::get().add(l);
+        } else {
+            EntityRegistry::get().remove<LightComponent>(id);
+        }
+    }
+
+    Light* getLight() const {
+        LightComponent* component = EntityRegistry::get().find<LightComponent>(id);
+        return component ? component->light : nullptr;
     }
 
     bool isVisible() const {
@@ -75,31 +139,92 @@ public:
     }
 
     void setModel(Model* model) {
-        this->model = model;
+        TransformStore::get().setFlag(transform.getHandle(), TransformStore::BOUNDED, model != nullptr);
+        EntityRegistry& registry = EntityRegistry::get();
+        if (model == nullptr) {
+            registry.remove<Renderable>(id);
+        } else if (Renderable* renderable = registry.find<Renderable>(id)) {
+            if (renderable->model == model) return;
+            renderable->model = model;
+            // the box changes with the model, a dirty slot lands in changedFlagged and the scene BVH refits its leaf
+            TransformStore& store = TransformStore::get();
+            store.markDirty(store.slot(transform.getHandle()));
+        } else {
+            registry.add<Renderable>(id, {model, STANDARD});
+        }
+    }
+
+    Model* getModel() const {
+        Renderable* renderable = EntityRegistry::get().find<Renderable>(id);
+        return renderable ? renderable->model : nullptr;
     }
 
     void setInstance(Instance* instance) {
-        this->instance = instance;
+        if (instance) EntityRegistry::get().add<InstanceComponent>(id, {instance});
+        else EntityRegistry::get().remove<InstanceComponent>(id);
+        TransformStore::get().setFlag(transform.getHandle(), TransformStore::INSTANCED, isInstanced());
+    }
+
+    // The node's world matrix becomes the transform of the record, null detaches it.
+    void setPrefabInstance(PrefabInstancer* instancer, uint32_t record = 0) {
+        if (instancer) EntityRegistry::get().add<PrefabComponent>(id, {instancer, record});
+        else EntityRegistry::get().remove<PrefabComponent>(id);
+        TransformStore::get().setFlag(transform.getHandle(), TransformStore::INSTANCED, isInstanced());
+    }
+
+    PrefabComponent* getPrefabInstance() const {
+        return EntityRegistry::get().find<PrefabComponent>(id);
     }
 
-    void setLabel(std::string l) {
-        this->label = l;
+    Instance* getInstance() const {
+        InstanceComponent* component = EntityRegistry::get().find<InstanceComponent>(id);
+        return component ? component->instance : nullptr;
     }
 
-    char* getLabel() {
-        return this->label.data();
+    void setLabel(const std::string& l) {
+        labelId = NodeRegistry::get().intern(l);
+        NodeRegistry::get().relabel(id, labelId);
     }
 
+    const char* getLabel() const {
+        return NodeRegistry::get().name(labelId).c_str();
+    }
+
+    NodeRegistry::NodeId getId() const {
+        return id;
+    }
+
+    static Node* findById(NodeRegistry::NodeId id) {
+        return NodeRegistry::get().findById(id);
+    }
+
+    // non-stationary nodes get an Animated component with a random spin speed
     void setStationary(bool value) {
-        stationary = value;
+        EntityRegistry& registry = EntityRegistry::get();
+        if (value) {
+            registry.remove<Animated>(id);
+        } else if (!registry.find<Animated>(id)) {
+            registry.add<Animated>(id);
+            setRandomRotationSpeed();
+        }
+    }
+
+    // large, solid nodes that hide what is behind them, see OcclusionCuller
+    void setOccluder(bool value) {
+        if (value) EntityRegistry::get().add<Occluder>(id);
+        else EntityRegistry::get().remove<Occluder>(id);
+    }
+
+    bool isOccluder() const {
+        return EntityRegistry::get().pool<Occluder>().has(id);
     }
 
-    bool isStationary() {
-        return stationary;
+    bool isStationary() const {
+        return EntityRegistry::get().find<Animated>(id) == nullptr;
     }
 
-    bool isInstanced() {
-        return instance;
+    bool isInstanced() const {
+        return getInstance() != nullptr || getPrefabInstance() != nullptr;
     }
 
 
@@ -121,28 +246,83 @@ public:
     void addChild(const TArgs&... args) {
         children.push_back(std::make_unique<Node>(args...));
         children.back()->parent = this;
+        children.back()->transform.setParent(&transform);
         children.back()->wireframe = wireframe;
     }
 
     void addChild(Node* node) {
         children.push_back(std::unique_ptr<Node>(node));
         children.back()->parent = this;
+        children.back()->transform.setParent(&transform);
         children.back()->wireframe = wireframe;
     }
 
     void addChild(Model* model) {
         children.push_back(std::make_unique<Node>(model));
         children.back()->parent = this;
+        children.back()->transform.setParent(&transform);
         children.back()->wireframe = wireframe;
     }
 
     void addChild(std::unique_ptr<Node> node) {
         node->parent = this;
+        node->transform.setParent(&transform);
         children.push_back(std::move(node));
         children.back()->wireframe = wireframe;
     }
 
 
+    // Creates a copy of this node and its whole subtree. Lights and instances are not copied.
+    Node* clone() const {
+        Node* copy = new Node(getModel());
+        copy->transform = transform;
+        copy->setStationary(isStationary());
+        copy->setOccluder(isOccluder());
+        copy->labelId = labelId;
+        NodeRegistry::get().relabel(copy->id, labelId);
+        copy->visible = visible;
+        copy->setMaterial(getMaterial());
+        copy->wireframe = wireframe;
+        copy->children.reserve(children.size());
+        for (auto&& child : children) {
+            copy->addChild(child->clone());
+        }
+        return copy;
+    }
+
+    // Adds count copies of prefab as children of this node and returns them.
+    // Copy i takes transforms[i] as its local TRS, copies past the end of transforms keep the prefab's.
+    // The arena, the TransformStore and the registry are grown once up front.
+    std::vector<Node*> spawnBatch(size_t count, const Node& prefab, const std::vector<SpawnTransform>& transforms) {
+        const size_t total = count * prefab.subtreeSize();
+        arena().reserve(total);
+        TransformStore::get().reserve(total);
+        NodeRegistry::get().reserve(total);
+        children.reserve(children.size() + count);
+
+        std::vector<Node*> spawned;
+        spawned.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            Node* copy = prefab.clone();
+            if (i < transforms.size()) {
+                copy->transform.setLocalPosition(transforms[i].position);
+                copy->transform.setEulerRotation(transforms[i].eulerRotation);
+                copy->transform.setScale(transforms[i].scale);
+            }
+            addChild(copy);
+            spawned.push_back(copy);
+        }
+        return spawned;
+    }
+
+    size_t subtreeSize() const {
+        size_t size = 1;
+        for (auto&& child : children) {
+            size += child->subtreeSize();
+        }
+        return size;
+    }
+
     void setParent(Node* newParent) {
         if (parent) {
             // find and remove current node from original parent's position
@@ -168,113 +348,167 @@ public:
 
     void removeChild(Node* node) {
         for (int i = 0; i < children.size(); i++) {
-            if (children[i]->label == node->label) {
+            if (children[i].get() == node) {
                 children.erase(children.begin() + i);
+                return;
             }
         }
     }
 
 
-    void updateSelfAndChild(float& deltaTime) {
-        Update(deltaTime);
-        if (transform.isDirty()) {
-            forceUpdateSelfAndChild(deltaTime);
-            return;
+    // Updates this node and everything below it: spins the Animated entities, recomputes the world matrices
+    // below dirty slots in the TransformStore, re-syncs instances whose world matrix changed and pushes light positions.
+    // Nodes outside the subtree are left alone. Every step only walks the entities that have the component,
+    // and clean subtrees are skipped. With a pool, large subtrees are propagated in parallel.
+    void updateSelfAndChild(float& deltaTime, ThreadPool* pool = nullptr) {
+        TransformStore& store = TransformStore::get();
+        EntityRegistry& registry = EntityRegistry::get();
+        const TransformStore::Handle handle = transform.getHandle();
+
+        auto [begin, end] = store.subtreeRange(handle);
+        registry.view<Animated, TransformComponent>().each([&](Entity, Animated& animated, TransformComponent& t) {
+            const uint32_t s = store.slot(t.handle);
+            if (s < begin || s >= end) return;
+            glm::vec3 rotation = store.eulerRotations[s];
+            rotation.y += 10.0f * deltaTime * animated.rotationSpeed;
+            if (rotation.y > 360) rotation.y = 0;
+            store.setEulerRotation(s, rotation);
+        });
+
+        store.update(handle, pool);
+
+        for (uint32_t s : store.changedFlagged) {
+            if (store.flags[s] & TransformStore::INSTANCED) {
+                store.owners[s]->syncInstance();
+            }
         }
 
-        for (const std::unique_ptr<Node>& child : children)
-        {
-            child->updateSelfAndChild(deltaTime);
-        }
+        std::tie(begin, end) = store.subtreeRange(handle);
+        registry.view<LightComponent, TransformComponent>().each([&](Entity, LightComponent& l, TransformComponent& t) {
+            const uint32_t s = store.slot(t.handle);
+            if (s < begin || s >= end) return;
+            l.light->setPosition(glm::vec3(store.worldMatrices[s][3]));
+        });
     }
 
-    void forceUpdateSelfAndChild(float& deltaTime) {
-        if (parent) {
-            Update(deltaTime);
-            transform.computeModelMatrix(parent->transform.getModelMatrix());
-            if (instance) {
-                instance->modelMatrix = transform.getModelMatrix();
-                instance->parentManager->updateModelMatrix(instance->id, transform.getModelMatrix());
-                instance->parentManager->isDirty = true;
-            }
-        }
-        else
-            transform.computeModelMatrix();
+    // updateSelfAndChild() with this node's world matrix recomputed even if nothing changed
+    void forceUpdateSelfAndChild(float& deltaTime, ThreadPool* pool = nullptr) {
+        TransformStore& store = TransformStore::get();
+        store.markDirty(store.slot(transform.getHandle()));
+        updateSelfAndChild(deltaTime, pool);
+    }
 
-        for (const std::unique_ptr<Node>& child : children)
-        {
-            child->forceUpdateSelfAndChild(deltaTime);
+    void syncInstance() {
+        if (PrefabComponent* prefab = getPrefabInstance()) {
+            prefab->instancer->setTransform(prefab->record, transform.getModelMatrix());
         }
-
+        Instance* instance = getInstance();
+        if (!instance) return;
+        instance->modelMatrix = transform.getModelMatrix();
+        instance->parentManager->updateModelMatrix(instance->id, transform.getModelMatrix());
     }
 
     void Draw(Shader* shader, unsigned int& cubemapTexture) {
         if (!visible) return;
 
-        if (*wireframe == true) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
+        GLStateCache::get().polygonMode(*wireframe ? GL_LINE : GL_FILL);
 
-        if (model) {
+        if (Renderable* renderable = EntityRegistry::get().find<Renderable>(id)) {
 
-            model->Draw(shader, cubemapTexture);
+            renderable->model->Draw(shader, cubemapTexture, renderable->lod);
         }
     }
 
-    Node* find(std::string l) {
-        if (getLabel() == l) return this;  // return the current node if it matches the label
-
-        // Recursively search in children
-        for (auto&& child : children) {
-            Node* result = child->find(l);  // Recursively search in the child
-            if (result != nullptr) {
-                return result;  // If found, return the result
+    // Looks the label up in the NodeRegistry and returns the first node carrying it in a depth-first walk of
+    // this subtree, this node included, same as searching the children recursively would.
+    // Only nodes with the label are visited: each one costs a parent walk plus a scan of its ancestors' sibling lists.
+    Node* find(const std::string& l) {
+        NodeRegistry& registry = NodeRegistry::get();
+        NodeRegistry::LabelId label = registry.lookup(l);
+        if (label == NodeRegistry::INVALID) return nullptr;
+
+        Node* best = nullptr;
+        std::vector<size_t> bestPath;
+        std::vector<size_t> path;
+        for (NodeRegistry::NodeId candidate : registry.nodesWithLabel(label)) {
+            Node* node = registry.findById(candidate);
+            if (!node->isInSubtreeOf(this)) continue;
+
+            // child indices from this node down to the candidate, compared lexicographically they give pre-order
+            path.clear();
+            for (const Node* n = node; n != this; n = n->parent) {
+                path.push_back(n->childIndex());
+            }
+            std::reverse(path.begin(), path.end());
+            if (best == nullptr || path < bestPath) {
+                best = node;
+                bestPath.swap(path);
             }
         }
 
-        return nullptr;
+        return best;
+    }
+
+    // position of this node among its parent's children
+    size_t childIndex() const {
+        const auto& siblings = parent->children;
+        for (size_t i = 0; i < siblings.size(); i++) {
+            if (siblings[i].get() == this) return i;
+        }
+        return siblings.size();
+    }
+
+    bool isInSubtreeOf(const Node* ancestor) const {
+        for (const Node* n = this; n != nullptr; n = n->parent) {
+            if (n == ancestor) return true;
+        }
+        return false;
+    }
+
+    float getRotationSpeed() const {
+        Animated* animated = EntityRegistry::get().find<Animated>(id);
+        return animated ? animated->rotationSpeed : 0.0f;
     }
 
-    float rotationSpeed = 0;
+    // only has an effect on non-stationary nodes
+    void setRotationSpeed(float speed) {
+        if (Animated* animated = EntityRegistry::get().find<Animated>(id)) {
+            animated->rotationSpeed = speed;
+        }
+    }
 
     void setRandomRotationSpeed() {
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
         std::uniform_int_distribution<> dis(2, 5);
 
-        rotationSpeed = dis(gen);
+        setRotationSpeed(dis(Util::rng()));
         // std::cout << "Rotation speed set to: " << rotationSpeed << std::endl;
     }
 
     void setRandomRotation() {
-        std::random_device rd;
-        std::mt19937 gen(rd());
         std::uniform_int_distribution<> dis(-5, 5);
 
-        transform.setEulerRotation({dis(gen), 0.f, -dis(gen)});
+        transform.setEulerRotation({dis(Util::rng()), 0.f, -dis(Util::rng())});
     }
 
-    void Update(float deltaTime) {
-        // std::cout << "Updating node" << std::endl;
-        if (light) {
-            // if (light->type == POINT) {
-            light->setForTypeVec3("position", transform.getGlobalPosition());
-            // }
+    // the material only applies to nodes with a model
+    void setMaterial(Material material) {
+        if (Renderable* renderable = EntityRegistry::get().find<Renderable>(id)) {
+            renderable->material = material;
         }
-        if (stationary) return;
-
-        glm::vec3 rotation = transform.getEulerRotation();
-        rotation.y += 10.0f * deltaTime * rotationSpeed;
-        if (rotation.y > 360) rotation.y = 0;
-        transform.setEulerRotation(rotation);
+    }
 
+    Material getMaterial() const {
+        Renderable* renderable = EntityRegistry::get().find<Renderable>(id);
+        return renderable ? renderable->material : STANDARD;
     }
 
-    void setMaterial(Material material) {
-        this->material = material;
+    // false if this node or any of its ancestors is hidden
+    bool isVisibleInHierarchy() const {
+        for (const Node* n = this; n != nullptr; n = n->parent) {
+            if (!n->visible) return false;
+        }
+        return true;
     }
 
 };
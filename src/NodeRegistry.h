@@ -0,0 +1,108 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef NODEREGISTRY_H
+#define NODEREGISTRY_H
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Node;
+
+// Scene-wide index of every live Node.
+// Labels are interned once, so nodes only store a small id, and both the name -> nodes
+// and the id -> node lookups are a hash or an array access instead of a walk over the tree.
+class NodeRegistry {
+public:
+    using LabelId = uint32_t;
+    using NodeId = uint32_t;
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    static NodeRegistry& get() {
+        static NodeRegistry registry;
+        return registry;
+    }
+
+    LabelId intern(const std::string& label) {
+        auto it = labelIds.find(label);
+        if (it != labelIds.end()) return it->second;
+
+        LabelId id = static_cast<LabelId>(labels.size());
+        labels.push_back(label);
+        labelNodes.emplace_back();
+        labelIds.emplace(labels.back(), id);
+        return id;
+    }
+
+    // INVALID if no node ever used the label
+    LabelId lookup(const std::string& label) const {
+        auto it = labelIds.find(label);
+        return it != labelIds.end() ? it->second : INVALID;
+    }
+
+    const std::string& name(LabelId label) const {
+        return labels[label];
+    }
+
+    // ids are never reused, so a stale id simply resolves to nullptr
+    NodeId add(Node* node, LabelId label) {
+        NodeId id = static_cast<NodeId>(entries.size());
+        entries.push_back({node, label, static_cast<uint32_t>(labelNodes[label].size())});
+        labelNodes[label].push_back(id);
+        return id;
+    }
+
+    void reserve(size_t count) {
+        entries.reserve(entries.size() + count);
+    }
+
+    void remove(NodeId id) {
+        unlink(id);
+        entries[id].node = nullptr;
+    }
+
+    void relabel(NodeId id, LabelId label) {
+        if (entries[id].label == label) return;
+        unlink(id);
+        entries[id].label = label;
+        entries[id].labelIndex = static_cast<uint32_t>(labelNodes[label].size());
+        labelNodes[label].push_back(id);
+    }
+
+    Node* findById(NodeId id) const {
+        return id < entries.size() ? entries[id].node : nullptr;
+    }
+
+    // every live node carrying the label, in no particular order
+    const std::vector<NodeId>& nodesWithLabel(LabelId label) const {
+        return labelNodes[label];
+    }
+
+private:
+    struct Entry {
+        Node* node;
+        LabelId label;
+        uint32_t labelIndex;   // position inside labelNodes[label]
+    };
+
+    std::unordered_map<std::string, LabelId> labelIds;
+    std::deque<std::string> labels;    // deque keeps the c_str() handed out by Node::getLabel() valid
+    std::vector<std::vector<NodeId>> labelNodes;
+    std::vector<Entry> entries;
+
+    NodeRegistry() = default;
+
+    // swap-remove from the label list
+    void unlink(NodeId id) {
+        std::vector<NodeId>& list = labelNodes[entries[id].label];
+        const uint32_t index = entries[id].labelIndex;
+        list[index] = list.back();
+        entries[list[index]].labelIndex = index;
+        list.pop_back();
+    }
+};
+
+#endif //NODEREGISTRY_H
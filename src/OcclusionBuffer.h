@@ -0,0 +1,190 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Mesh.h"
+#include "Simd.h"
+
+// Low resolution software depth buffer for occlusion culling.
+// Occluder triangles are clipped against the near plane and rasterized four pixels at a time.
+// Pixels store 1 / w, which is linear in screen space, so larger values are nearer and an empty pixel is 0.
+// A box is hidden when every pixel under its screen rectangle holds something nearer than its nearest corner.
+class OcclusionBuffer {
+public:
+    static constexpr int DEFAULT_WIDTH = 320;
+
+    int width = 0;     // multiple of four
+    int height = 0;
+    std::vector<float> depth;
+
+    // filled by rasterize(), for the inspector
+    size_t rasterizedTriangles = 0;
+
+    void resize(int newWidth, int newHeight) {
+        newWidth = (std::max(newWidth, 4) + 3) & ~3;
+        newHeight = std::max(newHeight, 1);
+        if (newWidth == width && newHeight == height) return;
+        width = newWidth;
+        height = newHeight;
+        depth.assign(static_cast<size_t>(width) * height, 0.0f);
+    }
+
+    void clear(const glm::mat4& viewProjection) {
+        this->viewProjection = viewProjection;
+        std::fill(depth.begin(), depth.end(), 0.0f);
+        rasterizedTriangles = 0;
+    }
+
+    void rasterize(const glm::mat4& model, const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount) {
+        const glm::mat4 mvp = viewProjection * model;
+        clipVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            clipVertices[i] = mvp * glm::vec4(vertices[i].position, 1.0f);
+        }
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            drawClipped(clipVertices[indices[i]], clipVertices[indices[i + 1]], clipVertices[indices[i + 2]]);
+        }
+        rasterizedTriangles += indexCount / 3;
+    }
+
+    bool isVisible(const AABB& box) const {
+        if (!box.isValid() || depth.empty()) return true;
+
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+        float nearest = 0.0f;
+        for (int i = 0; i < 8; i++) {
+            const glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            const glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            // crossing the near plane, the projection is unbounded
+            if (clip.z < -clip.w) return true;
+            const glm::vec3 screen = toScreen(clip);
+            minX = std::min(minX, screen.x);
+            maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y);
+            maxY = std::max(maxY, screen.y);
+            nearest = std::max(nearest, screen.z);
+        }
+
+        const int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+        const int x1 = std::min(width - 1, static_cast<int>(std::floor(maxX)));
+        const int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+        const int y1 = std::min(height - 1, static_cast<int>(std::floor(maxY)));
+        if (x0 > x1 || y0 > y1) return true;
+
+        const simd::float4 boxDepth = simd::splat(nearest);
+        for (int y = y0; y <= y1; y++) {
+            const float* row = &depth[static_cast<size_t>(y) * width];
+            for (int x = x0 & ~3; x <= x1; x += 4) {
+                int lanes = 0xF;
+                if (x < x0) lanes &= 0xF << (x0 - x);
+                if (x + 3 > x1) lanes &= 0xF >> (x + 3 - x1);
+                if (simd::moveMask(simd::cmpge(boxDepth, simd::load(row + x))) & lanes) return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<glm::vec4> clipVertices;
+
+    glm::vec3 toScreen(const glm::vec4& clip) const {
+        const float invW = 1.0f / clip.w;
+        return glm::vec3((clip.x * invW * 0.5f + 0.5f) * width, (clip.y * invW * 0.5f + 0.5f) * height, invW);
+    }
+
+    // Sutherland-Hodgman against the near plane z >= -w, leaves at most a quad
+    void drawClipped(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+        const glm::vec4 in[3] = {a, b, c};
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4& current = in[i];
+            const glm::vec4& next = in[(i + 1) % 3];
+            const float dCurrent = current.z + current.w;
+            const float dNext = next.z + next.w;
+            if (dCurrent >= 0.0f) polygon[count++] = current;
+            if ((dCurrent >= 0.0f) != (dNext >= 0.0f)) {
+                polygon[count++] = current + (next - current) * (dCurrent / (dCurrent - dNext));
+            }
+        }
+        if (count < 3) return;
+
+        const glm::vec3 first = toScreen(polygon[0]);
+        for (int i = 1; i + 1 < count; i++) {
+            drawTriangle(first, toScreen(polygon[i]), toScreen(polygon[i + 1]));
+        }
+    }
+
+    // Edge functions E(x, y) = A x + B y + C are positive inside, depth is interpolated as a plane of the same form.
+    // Both windings are drawn, occluders like the ground are seen from either side.
+    void drawTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::abs(area) < 1e-8f) return;
+        if (area < 0.0f) {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        const int minX = std::max(0, static_cast<int>(std::floor(std::min({v0.x, v1.x, v2.x}))));
+        const int maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max({v0.x, v1.x, v2.x}))));
+        const int minY = std::max(0, static_cast<int>(std::floor(std::min({v0.y, v1.y, v2.y}))));
+        const int maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max({v0.y, v1.y, v2.y}))));
+        if (minX > maxX || minY > maxY) return;
+
+        // edge i is opposite vertex i
+        const glm::vec3* from[3] = {&v1, &v2, &v0};
+        const glm::vec3* to[3] = {&v2, &v0, &v1};
+        float A[3], B[3], C[3];
+        for (int i = 0; i < 3; i++) {
+            A[i] = from[i]->y - to[i]->y;
+            B[i] = to[i]->x - from[i]->x;
+            C[i] = -(A[i] * from[i]->x + B[i] * from[i]->y);
+        }
+        const float invArea = 1.0f / area;
+        const float zA = (A[0] * v0.z + A[1] * v1.z + A[2] * v2.z) * invArea;
+        const float zB = (B[0] * v0.z + B[1] * v1.z + B[2] * v2.z) * invArea;
+        const float zC = (C[0] * v0.z + C[1] * v1.z + C[2] * v2.z) * invArea;
+
+        const int startX = minX & ~3;
+        const simd::float4 xs = simd::set(startX + 0.5f, startX + 1.5f, startX + 2.5f, startX + 3.5f);
+        const simd::float4 zero = simd::splat(0.0f);
+        simd::float4 a[3], step[3];
+        for (int i = 0; i < 3; i++) {
+            a[i] = simd::splat(A[i]);
+            step[i] = simd::splat(A[i] * 4.0f);
+        }
+        const simd::float4 zStep = simd::splat(zA * 4.0f);
+
+        for (int y = minY; y <= maxY; y++) {
+            const float py = y + 0.5f;
+            simd::float4 e0 = simd::madd(a[0], xs, simd::splat(B[0] * py + C[0]));
+            simd::float4 e1 = simd::madd(a[1], xs, simd::splat(B[1] * py + C[1]));
+            simd::float4 e2 = simd::madd(a[2], xs, simd::splat(B[2] * py + C[2]));
+            simd::float4 z = simd::madd(simd::splat(zA), xs, simd::splat(zB * py + zC));
+
+            float* row = &depth[static_cast<size_t>(y) * width];
+            for (int x = startX; x <= maxX; x += 4) {
+                const simd::float4 inside = simd::maskAnd(simd::cmpge(e0, zero), simd::maskAnd(simd::cmpge(e1, zero), simd::cmpge(e2, zero)));
+                if (simd::moveMask(inside)) {
+                    const simd::float4 old = simd::load(row + x);
+                    simd::store(row + x, simd::select(inside, simd::max(old, z), old));
+                }
+                e0 = simd::add(e0, step[0]);
+                e1 = simd::add(e1, step[1]);
+                e2 = simd::add(e2, step[2]);
+                z = simd::add(z, zStep);
+            }
+        }
+    }
+};
+
+#endif //OCCLUSIONBUFFER_H
@@ -0,0 +1,140 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+#include <algorithm>
+#include <vector>
+
+#include "EntityRegistry.h"
+#include "Frustum.h"
+#include "Node.h"
+#include "OcclusionBuffer.h"
+#include "ThreadPool.h"
+
+// Picks the occluders that cover the most screen this frame and rasterizes them on a worker thread
+// while the main thread keeps going. finish() waits for the buffer, after that isVisible() can be asked.
+class OcclusionCuller {
+public:
+    bool enabled = true;
+    size_t maxOccluders = 32;
+    // occluder meshes with more triangles than this are rasterized at the most detailed simplified level that fits,
+    // or at their coarsest level when none does
+    size_t maxOccluderTriangles = 512;
+
+    OcclusionBuffer buffer;
+
+    // stats of the current frame
+    size_t occluderCount = 0;
+    size_t testedCount = 0;
+    size_t occludedCount = 0;
+
+    // Collects the occluders inside the frustum and starts rasterizing them. Call after the transform update.
+    void begin(const glm::mat4& viewProjection, const Frustum& frustum, const glm::vec3& cameraPosition, float aspectRatio, ThreadPool* pool = nullptr) {
+        testedCount = 0;
+        occludedCount = 0;
+        active = enabled;
+        if (!active) {
+            occluderCount = 0;
+            return;
+        }
+
+        buffer.resize(OcclusionBuffer::DEFAULT_WIDTH, static_cast<int>(OcclusionBuffer::DEFAULT_WIDTH / aspectRatio));
+        this->viewProjection = viewProjection;
+        gather(frustum, cameraPosition);
+        occluderCount = jobs.size();
+
+        if (pool) {
+            pool->submit([this] { rasterizeJobs(); });
+        } else {
+            rasterizeJobs();
+        }
+    }
+
+    void finish(ThreadPool* pool = nullptr) {
+        if (pool) pool->wait();
+    }
+
+    bool isActive() const {
+        return active;
+    }
+
+    bool isVisible(const AABB& worldBox) {
+        if (!active) return true;
+        testedCount++;
+        if (buffer.isVisible(worldBox)) return true;
+        occludedCount++;
+        return false;
+    }
+
+    // Removes hidden instances from the manager's visible set. Call after its frustum cull().
+    void cull(InstanceManager& manager, ThreadPool* pool = nullptr) {
+        if (!active || !manager.cullingEnabled) return;
+        const size_t before = manager.visibleCount;
+        manager.occlude(buffer, pool);
+        testedCount += before;
+        occludedCount += before - manager.visibleCount;
+    }
+
+private:
+    struct Job {
+        const Model* model;
+        glm::mat4 world;
+        float score;    // radius over distance, roughly the screen size
+    };
+
+    std::vector<Job> jobs;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    bool active = false;
+
+    void gather(const Frustum& frustum, const glm::vec3& cameraPosition) {
+        jobs.clear();
+        EntityRegistry& registry = EntityRegistry::get();
+        TransformStore& store = TransformStore::get();
+        registry.view<Occluder, TransformComponent>().each([&](Entity entity, Occluder&, TransformComponent& transform) {
+            const Model* model = nullptr;
+            glm::mat4 world = store.worldMatrices[store.slot(transform.handle)];
+            if (Renderable* renderable = registry.find<Renderable>(entity)) {
+                model = renderable->model;
+            } else if (InstanceComponent* instance = registry.find<InstanceComponent>(entity)) {
+                model = &instance->instance->model;
+            } else if (PrefabComponent* prefab = registry.find<PrefabComponent>(entity)) {
+                if (prefab->instancer->getParts().empty()) return;
+                const PrefabInstancer::Part& part = prefab->instancer->getParts().front();
+                model = part.model;
+                world = world * part.offset;
+            }
+            if (!model || model->meshes.empty()) return;
+
+            const float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+            BoundingSphere sphere;
+            sphere.center = glm::vec3(world * glm::vec4(model->sphere.center, 1.0f));
+            sphere.radius = model->sphere.radius * scale;
+            if (!frustum.intersects(sphere)) return;
+
+            const float distance = std::max(glm::length(sphere.center - cameraPosition), 0.001f);
+            jobs.push_back({model, world, sphere.radius / distance});
+        });
+
+        if (jobs.size() > maxOccluders) {
+            std::nth_element(jobs.begin(), jobs.begin() + maxOccluders, jobs.end(), [](const Job& a, const Job& b) {
+                return a.score > b.score;
+            });
+            jobs.resize(maxOccluders);
+        }
+    }
+
+    void rasterizeJobs() {
+        buffer.clear(viewProjection);
+        for (const Job& job : jobs) {
+            for (const Mesh& mesh : job.model->meshes) {
+                int lod = 0;
+                while (lod + 1 < static_cast<int>(mesh.lods.size()) && mesh.lods[lod].indexCount / 3 > maxOccluderTriangles) lod++;
+                buffer.rasterize(job.world, mesh.vertices, mesh.getLodIndices(lod), mesh.getLod(lod).indexCount);
+            }
+        }
+    }
+};
+
+#endif //OCCLUSIONCULLER_H
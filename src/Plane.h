@@ -6,6 +6,7 @@
 #include <string>
 #include <iostream>
 #include <glad/glad.h>
+#include "GLStateCache.h"
 #include "Mesh.h"
 #include <stb_image.h>
 
@@ -65,7 +66,7 @@ private:
         if (data) {
             GLenum format = (nrChannels == 3) ? GL_RGB : GL_RGBA;
 
-            glBindTexture(GL_TEXTURE_2D, textureID);
+            GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, textureID);
             glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
             glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -0,0 +1,194 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef PREFABINSTANCER_H
+#define PREFABINSTANCER_H
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Frustum.h"
+#include "GeometryPool.h"
+#include "GLStateCache.h"
+#include "Lod.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+
+// Instances of a prefab made of several models at fixed offsets, like a house body with its roof on top.
+// One record per instance drives every part: its transform, a tint multiplied into the shaded color,
+// the material and the level of detail. The vertex shader puts the part at its offset (uniform "part")
+// before applying the instance transform, so parts need no records of their own.
+//
+// Every frame the visible records are bucketed by material and level and streamed in that order,
+// then each part draws a bucket with one instanced call. Materials use different programs,
+// draw() does one material at a time so the caller can put each one in its pass.
+class PrefabInstancer {
+public:
+    // STANDARD, REFLECTIVE, REFRACTIVE
+    static constexpr int MATERIAL_COUNT = 3;
+    // a record on this level picks it from the distance, like nodes do
+    static constexpr int8_t AUTO_LOD = -1;
+
+    struct Part {
+        Model* model;
+        glm::mat4 offset;    // from the prefab's origin
+    };
+
+    struct Record {
+        glm::mat4 transform = glm::mat4(1.0f);
+        glm::vec4 tint = glm::vec4(1.0f);
+        Material material = STANDARD;
+        int8_t lod = AUTO_LOD;
+    };
+
+    bool cullingEnabled = true;
+
+    // of the last update() and draw() calls, for the inspector
+    size_t visibleCount = 0;
+    size_t drawCount = 0;
+    size_t lodCounts[Mesh::MAX_LODS] = {};
+
+    void addPart(Model* model, const glm::mat4& offset = glm::mat4(1.0f)) {
+        parts.push_back({model, offset});
+        bounds.expand(model->bounds.transformed(offset));
+
+        // every part is drawn at the record's level, so a level is as coarse as its worst part.
+        // Parts with fewer levels keep drawing their last one, the offset's scale grows the error with the part.
+        const float scale = std::max(glm::length(glm::vec3(offset[0])), std::max(glm::length(glm::vec3(offset[1])), glm::length(glm::vec3(offset[2]))));
+        const int count = model->getLodCount();
+        if (static_cast<int>(lodErrors.size()) < count) lodErrors.resize(count, lodErrors.empty() ? 0.0f : lodErrors.back());
+        for (size_t lod = 0; lod < lodErrors.size(); lod++) {
+            const float error = count > 0 ? model->lodErrors[std::min(static_cast<int>(lod), count - 1)] * scale : 0.0f;
+            lodErrors[lod] = std::max(lodErrors[lod], error);
+        }
+    }
+
+    const std::vector<Part>& getParts() const {
+        return parts;
+    }
+
+    uint32_t add() {
+        return add(Record());
+    }
+
+    uint32_t add(const Record& record) {
+        records.push_back(record);
+        selectedLods.push_back(0);
+        return static_cast<uint32_t>(records.size() - 1);
+    }
+
+    Record& getRecord(uint32_t id) {
+        return records[id];
+    }
+
+    void setTransform(uint32_t id, const glm::mat4& transform) {
+        records[id].transform = transform;
+    }
+
+    size_t size() const {
+        return records.size();
+    }
+
+    // Culls the records against the frustum and isVisible(worldBox), picks their levels, and streams the survivors
+    // grouped by material and level. Call once per frame, before draw().
+    template<typename Visible>
+    void update(const Frustum& frustum, Visible&& isVisible, const glm::vec3& cameraPosition, const LodSettings& settings) {
+        for (std::vector<uint32_t>& bucket : buckets) bucket.clear();
+        std::fill(std::begin(lodCounts), std::end(lodCounts), 0);
+        visibleCount = 0;
+        drawCount = 0;
+        if (parts.empty()) return;
+
+        const glm::vec3 center = bounds.getCenter();
+        const float radius = glm::length(bounds.getExtents());
+        for (uint32_t id = 0; id < records.size(); id++) {
+            const Record& record = records[id];
+            if (cullingEnabled) {
+                const AABB box = bounds.transformed(record.transform);
+                if (!frustum.intersects(box) || !isVisible(box)) continue;
+            }
+
+            int lod = record.lod;
+            if (lod == AUTO_LOD) {
+                const glm::mat4& m = record.transform;
+                const float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+                const glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+                const float distance = LodSettings::sphereDistance(cameraPosition, worldCenter, radius * scale);
+                lod = settings.select(lodErrors, scale, distance, selectedLods[id]);
+                selectedLods[id] = static_cast<uint8_t>(lod);
+            }
+            lod = std::clamp(lod, 0, Mesh::MAX_LODS - 1);
+            buckets[record.material * Mesh::MAX_LODS + lod].push_back(id);
+            lodCounts[lod]++;
+            visibleCount++;
+        }
+        if (visibleCount == 0) return;
+
+        if (!stream.getBuffer()) stream.create(GL_ARRAY_BUFFER, records.size() * sizeof(InstanceAttributes));
+        StreamingBuffer::Allocation allocation = stream.map(visibleCount * sizeof(InstanceAttributes));
+        if (!allocation.data) {
+            for (std::vector<uint32_t>& bucket : buckets) bucket.clear();
+            return;
+        }
+        InstanceAttributes* out = static_cast<InstanceAttributes*>(allocation.data);
+        size_t offset = allocation.offset;
+        for (size_t b = 0; b < buckets.size(); b++) {
+            bucketOffsets[b] = offset;
+            for (uint32_t id : buckets[b]) {
+                out->model = records[id].transform;
+                out->color = records[id].tint;
+                out++;
+            }
+            offset += buckets[b].size() * sizeof(InstanceAttributes);
+        }
+        stream.unmap();
+    }
+
+    // Draws every visible record of the material with a shader that reads the instance transform from attributes 3 to 6,
+    // the tint from 7 and the part offset from the "part" uniform. One instanced call per mesh and level.
+    void draw(Material material, Shader* shader, unsigned int skyboxTexture) {
+        const size_t first = material * Mesh::MAX_LODS;
+        bool any = false;
+        for (int lod = 0; lod < Mesh::MAX_LODS; lod++) any = any || !buckets[first + lod].empty();
+        if (!any) return;
+
+        shader->use();
+        const UniformHandle partUniform = shader->getUniform("part");
+        GLStateCache& state = GLStateCache::get();
+        for (const Part& part : parts) {
+            shader->set(partUniform, part.offset);
+            for (const Mesh& mesh : part.model->meshes) {
+                // meshes outside the geometry pool have no instancing vertex array
+                if (mesh.geometryBlock < 0) continue;
+                mesh.bindTextures(skyboxTexture);
+                state.bindVertexArray(GeometryPool::get().getInstancingVertexArray(mesh.geometryBlock));
+                for (int lod = 0; lod < Mesh::MAX_LODS; lod++) {
+                    const std::vector<uint32_t>& bucket = buckets[first + lod];
+                    if (bucket.empty()) continue;
+                    GeometryPool::pointInstanceAttributes(stream.getBuffer(), bucketOffsets[first + lod]);
+                    // parts with fewer levels draw their coarsest one
+                    mesh.drawElementsInstanced(lod, bucket.size());
+                    drawCount++;
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr size_t BUCKET_COUNT = MATERIAL_COUNT * Mesh::MAX_LODS;
+
+    std::vector<Part> parts;
+    AABB bounds;    // of all parts, in prefab space
+    std::vector<float> lodErrors;    // per level, the largest error of any part, in prefab space
+    std::vector<Record> records;
+    std::vector<uint8_t> selectedLods;    // last automatic level per record, for the hysteresis
+
+    std::vector<std::vector<uint32_t>> buckets = std::vector<std::vector<uint32_t>>(BUCKET_COUNT);    // material * MAX_LODS + lod
+    size_t bucketOffsets[BUCKET_COUNT] = {};
+    StreamingBuffer stream;
+};
+
+#endif //PREFABINSTANCER_H
@@ -0,0 +1,293 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "GeometryPool.h"
+#include "GLStateCache.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+
+// One draw call worth of state. The scene walk only fills these, GL state is touched when the queue executes.
+struct DrawPacket {
+    uint64_t key;
+    Shader* shader;
+    const Mesh* mesh;
+    const glm::mat4* model;    // world matrix in the TransformStore, valid until the next update
+    glm::vec3 color;           // only for emissive draws
+    uint8_t lod;
+    bool emissive;
+};
+
+// Collects draw packets, radix sorts them by key and executes them, changing program, textures
+// and vertex array only when the next packet needs different ones. Binds go through GLStateCache,
+// so the first packet doesn't rebind what the previous pass left bound.
+// Key layout, most significant first, so sorting groups by the costliest state change:
+//   pass 2 | shader 6 | material 2 | texture set 14 | vertex array 16 | depth 24
+// Shaders and vertex arrays are numbered densely in the order the queue first sees them, texture sets are dense
+// already (Mesh::internTextureSet). Every id is asserted to fit its field, a truncated one would alias another state.
+// Depth is the last tie breaker: opaque draws with the same state go front to back for early Z,
+// transparent ones back to front.
+//
+// Opaque packets of the same mesh and level that share all the state above are drawn with one instanced call
+// when their shader has an instanced variant, so repeated models don't need a hand-built InstanceManager.
+// Their matrices and colors go to a streaming buffer every frame, read through the pool's instancing vertex arrays.
+class RenderQueue {
+public:
+    enum Pass : uint64_t {
+        OPAQUE_PASS = 0,
+        TRANSPARENT_PASS = 1,
+    };
+
+    static constexpr uint32_t SHADER_BITS = 6;
+    static constexpr uint32_t TEXTURE_SET_BITS = 14;
+    static constexpr uint32_t VERTEX_ARRAY_BITS = 16;
+    static constexpr uint32_t DEPTH_BITS = 24;
+    // smaller groups are drawn one by one, pointing the instance attributes costs more than the draws it saves
+    static constexpr size_t MIN_INSTANCES = 4;
+
+    bool instancing = true;
+
+    // counted by execute(), for the inspector
+    size_t drawCount = 0;
+    size_t programChanges = 0;
+    size_t textureChanges = 0;
+    size_t vertexArrayChanges = 0;
+    size_t instancedDraws = 0;
+    size_t instancedPackets = 0;    // packets drawn by the instanced draws
+
+    // The variant reads the model matrix from attributes 3 to 6 and the color from attribute 7.
+    void setInstancedVariant(Shader* shader, Shader* instanced) {
+        shaders[shaderIndex(shader)].instanced = instanced;
+    }
+
+    // depth is the view distance divided by the far plane, clamped to [0, 1]
+    uint64_t makeKey(Pass pass, Shader* shader, Material material, const Mesh& mesh, float depth) {
+        uint64_t quantized = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * ((1u << DEPTH_BITS) - 1));
+        if (pass == TRANSPARENT_PASS) quantized = ((1u << DEPTH_BITS) - 1) - quantized;
+        assert(mesh.textureSet < (1u << TEXTURE_SET_BITS) && "RenderQueue: too many texture sets for the sort key");
+        return (static_cast<uint64_t>(pass) << 62)
+             | (static_cast<uint64_t>(shaderIndex(shader)) << 56)
+             | (static_cast<uint64_t>(material & 0x3) << 54)
+             | (static_cast<uint64_t>(mesh.textureSet) << 40)
+             | (static_cast<uint64_t>(vertexArrayIndex(mesh.VAO)) << 24)
+             | quantized;
+    }
+
+    void push(const DrawPacket& packet) {
+        packets.push_back(packet);
+    }
+
+    void clear() {
+        packets.clear();
+        entries.clear();
+    }
+
+    size_t size() const {
+        return packets.size();
+    }
+
+    // LSD radix sort on the keys, one byte per pass. Passes where every key has the same byte are skipped,
+    // which with few passes and shaders is most of the upper half.
+    void sort() {
+        const size_t count = packets.size();
+        entries.resize(count);
+        scratch.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            entries[i] = {packets[i].key, static_cast<uint32_t>(i)};
+        }
+
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t histogram[256] = {};
+            for (const Entry& entry : entries) {
+                histogram[(entry.key >> shift) & 0xFF]++;
+            }
+            if (count == 0 || histogram[(entries[0].key >> shift) & 0xFF] == count) continue;
+
+            size_t offset = 0;
+            for (size_t& bucket : histogram) {
+                const size_t bucketSize = bucket;
+                bucket = offset;
+                offset += bucketSize;
+            }
+            for (const Entry& entry : entries) {
+                scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+            }
+            entries.swap(scratch);
+        }
+    }
+
+    // Runs the sorted packets. The skybox cubemap is bound with every texture set, like Mesh::Draw does.
+    void execute(unsigned int skyboxTexture) {
+        drawCount = 0;
+        programChanges = 0;
+        textureChanges = 0;
+        vertexArrayChanges = 0;
+        instancedDraws = 0;
+        instancedPackets = 0;
+        groupInstances();
+
+        Shader* currentShader = nullptr;
+        unsigned int currentTextureSet = UINT32_MAX;
+        unsigned int currentVertexArray = 0;
+        auto bindState = [&](Shader* shader, const Mesh& mesh, unsigned int vertexArray) {
+            if (shader != currentShader) {
+                shader->use();
+                currentShader = shader;
+                programChanges++;
+            }
+            if (mesh.textureSet != currentTextureSet) {
+                mesh.bindTextures(skyboxTexture);
+                currentTextureSet = mesh.textureSet;
+                textureChanges++;
+            }
+            if (vertexArray != currentVertexArray) {
+                GLStateCache::get().bindVertexArray(vertexArray);
+                currentVertexArray = vertexArray;
+                vertexArrayChanges++;
+            }
+        };
+
+        for (const Group& group : groups) {
+            const ShaderSlot& slot = shaders[(entries[group.begin].key >> 56) & ((1u << SHADER_BITS) - 1)];
+            if (group.instanced) {
+                const DrawPacket& packet = packets[entries[group.begin].index];
+                bindState(slot.instanced, *packet.mesh, GeometryPool::get().getInstancingVertexArray(packet.mesh->geometryBlock));
+                GeometryPool::pointInstanceAttributes(instanceStream.getBuffer(), group.instanceOffset);
+                packet.mesh->drawElementsInstanced(packet.lod, group.end - group.begin);
+                drawCount++;
+                instancedDraws++;
+                instancedPackets += group.end - group.begin;
+                continue;
+            }
+            for (size_t i = group.begin; i < group.end; i++) {
+                const DrawPacket& packet = packets[entries[i].index];
+                bindState(packet.shader, *packet.mesh, packet.mesh->VAO);
+                packet.shader->set(slot.model, *packet.model);
+                if (packet.emissive) packet.shader->set(slot.color, packet.color);
+                packet.mesh->drawElements(packet.lod);
+                drawCount++;
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    // entries [begin, end) drawn with one instanced call, or one by one
+    struct Group {
+        size_t begin;
+        size_t end;
+        bool instanced;
+        size_t instanceOffset;    // bytes into the instance stream
+    };
+
+    std::vector<DrawPacket> packets;
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+    std::vector<Group> groups;
+    // per draw uniforms, resolved when the shader is first seen
+    struct ShaderSlot {
+        Shader* shader;
+        UniformHandle model;
+        UniformHandle color;
+        Shader* instanced;
+    };
+
+    std::vector<ShaderSlot> shaders;    // position is the shader's index in the keys
+    std::unordered_map<unsigned int, uint32_t> vertexArrays;    // GL name -> index in the keys
+
+    StreamingBuffer instanceStream;
+
+    uint32_t shaderIndex(Shader* shader) {
+        for (size_t i = 0; i < shaders.size(); i++) {
+            if (shaders[i].shader == shader) return static_cast<uint32_t>(i);
+        }
+        assert(shaders.size() < (1u << SHADER_BITS) && "RenderQueue: too many shaders for the sort key");
+        shaders.push_back({shader, shader->getUniform("model"), shader->getUniform("color"), nullptr});
+        return static_cast<uint32_t>(shaders.size() - 1);
+    }
+
+    uint32_t vertexArrayIndex(unsigned int vertexArray) {
+        auto it = vertexArrays.find(vertexArray);
+        if (it != vertexArrays.end()) return it->second;
+        assert(vertexArrays.size() < (1u << VERTEX_ARRAY_BITS) && "RenderQueue: too many vertex arrays for the sort key");
+        const uint32_t index = static_cast<uint32_t>(vertexArrays.size());
+        vertexArrays.emplace(vertexArray, index);
+        return index;
+    }
+
+    // Splits the sorted entries into runs with the same state. Opaque runs whose shader has an instanced variant
+    // are reordered by mesh and level, depth order is kept between equal draws, and every stretch of at least
+    // MIN_INSTANCES equal draws becomes an instanced group with its instance data in the stream.
+    void groupInstances() {
+        groups.clear();
+        size_t instanceCount = 0;
+        for (size_t runBegin = 0; runBegin < entries.size();) {
+            const uint64_t state = entries[runBegin].key >> DEPTH_BITS;
+            size_t runEnd = runBegin + 1;
+            while (runEnd < entries.size() && (entries[runEnd].key >> DEPTH_BITS) == state) runEnd++;
+
+            const bool opaque = (entries[runBegin].key >> 62) == OPAQUE_PASS;
+            if (!instancing || !opaque || !shaders[(entries[runBegin].key >> 56) & ((1u << SHADER_BITS) - 1)].instanced) {
+                groups.push_back({runBegin, runEnd, false, 0});
+                runBegin = runEnd;
+                continue;
+            }
+
+            std::stable_sort(entries.begin() + runBegin, entries.begin() + runEnd, [this](const Entry& a, const Entry& b) {
+                const DrawPacket& first = packets[a.index];
+                const DrawPacket& second = packets[b.index];
+                if (first.mesh != second.mesh) return std::less<const Mesh*>()(first.mesh, second.mesh);
+                return first.lod < second.lod;
+            });
+            for (size_t begin = runBegin; begin < runEnd;) {
+                const DrawPacket& packet = packets[entries[begin].index];
+                size_t end = begin + 1;
+                while (end < runEnd && packets[entries[end].index].mesh == packet.mesh && packets[entries[end].index].lod == packet.lod) end++;
+                // meshes outside the geometry pool have no block to build the instancing vertex array from
+                const bool instanced = end - begin >= MIN_INSTANCES && packet.mesh->geometryBlock >= 0;
+                groups.push_back({begin, end, instanced, instanceCount * sizeof(InstanceAttributes)});
+                if (instanced) instanceCount += end - begin;
+                begin = end;
+            }
+            runBegin = runEnd;
+        }
+        if (instanceCount == 0) return;
+
+        if (!instanceStream.getBuffer()) instanceStream.create(GL_ARRAY_BUFFER, instanceCount * sizeof(InstanceAttributes));
+        StreamingBuffer::Allocation allocation = instanceStream.map(instanceCount * sizeof(InstanceAttributes));
+        if (!allocation.data) {
+            for (Group& group : groups) group.instanced = false;
+            return;
+        }
+        InstanceAttributes* out = static_cast<InstanceAttributes*>(allocation.data);
+        for (Group& group : groups) {
+            if (!group.instanced) continue;
+            group.instanceOffset += allocation.offset;
+            for (size_t i = group.begin; i < group.end; i++) {
+                const DrawPacket& packet = packets[entries[i].index];
+                out->model = *packet.model;
+                out->color = glm::vec4(packet.color, 1.0f);
+                out++;
+            }
+        }
+        instanceStream.unmap();
+    }
+};
+
+#endif //RENDERQUEUE_H
@@ -0,0 +1,213 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef SCENEBVH_H
+#define SCENEBVH_H
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "Bounds.h"
+#include "EntityRegistry.h"
+#include "Frustum.h"
+#include "Node.h"
+
+// Bounding volume hierarchy over the world space boxes of every entity with a Renderable.
+// Rebuilt when entities gain or lose a model, refit bottom-up along the changed leaves otherwise.
+// A leaf changes when its transform moves or its model is swapped, Node::setModel() marks the slot dirty for that.
+// Refitting keeps the topology, so once as many boxes moved as there are items the tree is rebuilt
+// to keep moving objects from bloating it.
+// Children of node i are stored as a pair after it, so a parent always has a smaller index than its children.
+class SceneBVH {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr uint32_t MAX_LEAF_ITEMS = 4;
+
+    struct BVHNode {
+        AABB bounds;
+        uint32_t first;    // left child for inner nodes, first item for leaves
+        uint32_t count;    // 0 for inner nodes
+        uint32_t parent;
+    };
+
+    // filled by query(), for the inspector
+    size_t nodesVisited = 0;
+
+    // Brings the tree up to date with this frame's transforms. Call after the TransformStore update.
+    void update() {
+        ComponentPool<Renderable>& renderables = EntityRegistry::get().pool<Renderable>();
+        if (renderables.version != builtVersion || refitsSinceBuild > items.size()) {
+            build();
+            return;
+        }
+        refit();
+    }
+
+    // Appends every entity whose box touches the frustum.
+    // Subtrees fully outside are skipped, subtrees fully inside are taken without further tests.
+    void query(const Frustum& frustum, std::vector<Entity>& out) {
+        nodesVisited = 0;
+        if (nodes.empty()) return;
+
+        std::vector<std::pair<uint32_t, bool>> stack;    // node, already known to be inside
+        stack.emplace_back(0, false);
+        while (!stack.empty()) {
+            auto [index, inside] = stack.back();
+            stack.pop_back();
+            nodesVisited++;
+
+            const BVHNode& node = nodes[index];
+            if (!inside) {
+                Frustum::Result result = frustum.classify(node.bounds);
+                if (result == Frustum::OUTSIDE) continue;
+                inside = result == Frustum::INSIDE;
+            }
+
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    if (inside || frustum.intersects(itemBounds[i])) out.push_back(items[i]);
+                }
+            } else {
+                stack.emplace_back(node.first + 1, inside);
+                stack.emplace_back(node.first, inside);
+            }
+        }
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+private:
+    std::vector<BVHNode> nodes;
+    std::vector<Entity> items;            // grouped so every leaf owns a contiguous range
+    std::vector<AABB> itemBounds;
+    std::vector<uint32_t> itemLeaves;     // item -> leaf node
+    std::vector<uint32_t> itemOf;         // entity -> item, NONE if not in the tree
+    uint32_t builtVersion = UINT32_MAX;
+    size_t refitsSinceBuild = 0;
+
+    static AABB worldBounds(Entity entity) {
+        EntityRegistry& registry = EntityRegistry::get();
+        TransformStore& store = TransformStore::get();
+        const Renderable& renderable = registry.pool<Renderable>().get(entity);
+        const glm::mat4& world = store.worldMatrices[store.slot(registry.pool<TransformComponent>().get(entity).handle)];
+
+        AABB box = renderable.model->bounds.transformed(world);
+        if (!box.isValid()) box.expand(glm::vec3(world[3]));
+        return box;
+    }
+
+    void build() {
+        ComponentPool<Renderable>& renderables = EntityRegistry::get().pool<Renderable>();
+        builtVersion = renderables.version;
+        refitsSinceBuild = 0;
+
+        items = renderables.entities;
+        itemBounds.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++) {
+            itemBounds[i] = worldBounds(items[i]);
+        }
+
+        nodes.clear();
+        itemLeaves.assign(items.size(), 0);
+        if (items.empty()) return;
+
+        // no reallocation while split() holds references into nodes
+        nodes.reserve(2 * items.size());
+        nodes.push_back({AABB(), 0, static_cast<uint32_t>(items.size()), NONE});
+        split(0);
+
+        itemOf.assign(itemOf.size(), NONE);
+        for (uint32_t i = 0; i < items.size(); i++) {
+            if (items[i] >= itemOf.size()) itemOf.resize(items[i] + 1, NONE);
+            itemOf[items[i]] = i;
+        }
+    }
+
+    // Median split along the longest axis of the item centres.
+    void split(uint32_t index) {
+        BVHNode& node = nodes[index];
+        const uint32_t first = node.first;
+        const uint32_t count = node.count;
+
+        AABB centres;
+        node.bounds = AABB();
+        for (uint32_t i = first; i < first + count; i++) {
+            node.bounds.expand(itemBounds[i]);
+            centres.expand(itemBounds[i].getCenter());
+        }
+
+        if (count <= MAX_LEAF_ITEMS) {
+            for (uint32_t i = first; i < first + count; i++) {
+                itemLeaves[i] = index;
+            }
+            return;
+        }
+
+        const glm::vec3 size = centres.max - centres.min;
+        const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        const uint32_t half = count / 2;
+
+        // sort items and their boxes together through an index permutation
+        std::vector<uint32_t> order(count);
+        for (uint32_t i = 0; i < count; i++) order[i] = first + i;
+        std::nth_element(order.begin(), order.begin() + half, order.end(), [&](uint32_t a, uint32_t b) {
+            return itemBounds[a].getCenter()[axis] < itemBounds[b].getCenter()[axis];
+        });
+        std::vector<Entity> sortedItems(count);
+        std::vector<AABB> sortedBounds(count);
+        for (uint32_t i = 0; i < count; i++) {
+            sortedItems[i] = items[order[i]];
+            sortedBounds[i] = itemBounds[order[i]];
+        }
+        std::copy(sortedItems.begin(), sortedItems.end(), items.begin() + first);
+        std::copy(sortedBounds.begin(), sortedBounds.end(), itemBounds.begin() + first);
+
+        const uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes[index].first = left;
+        nodes[index].count = 0;
+        nodes.push_back({AABB(), first, half, index});
+        nodes.push_back({AABB(), first + half, count - half, index});
+        split(left);
+        split(left + 1);
+    }
+
+    // Recomputes the boxes of items whose transform changed, then walks their ancestors
+    // from the deepest up so every node is refit once, after its children.
+    void refit() {
+        TransformStore& store = TransformStore::get();
+        std::priority_queue<uint32_t> pending;
+
+        for (uint32_t s : store.changedFlagged) {
+            if (!(store.flags[s] & TransformStore::BOUNDED) || !store.owners[s]) continue;
+            const Entity entity = store.owners[s]->getId();
+            if (entity >= itemOf.size() || itemOf[entity] == NONE) continue;
+
+            const uint32_t item = itemOf[entity];
+            itemBounds[item] = worldBounds(entity);
+            pending.push(itemLeaves[item]);
+            refitsSinceBuild++;
+        }
+        while (!pending.empty()) {
+            const uint32_t index = pending.top();
+            pending.pop();
+            while (!pending.empty() && pending.top() == index) pending.pop();
+
+            BVHNode& node = nodes[index];
+            node.bounds = AABB();
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    node.bounds.expand(itemBounds[i]);
+                }
+            } else {
+                node.bounds.expand(nodes[node.first].bounds);
+                node.bounds.expand(nodes[node.first + 1].bounds);
+            }
+            if (node.parent != NONE) pending.push(node.parent);
+        }
+    }
+};
+
+#endif //SCENEBVH_H
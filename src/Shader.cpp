@@ -4,7 +4,55 @@
 
 #include "Shader.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath) {
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+// Inserts a #define line for every name in defines after the #version line, which has to stay first.
+static std::string addDefines(const std::string& code, const char* defines) {
+    if (defines == nullptr) return code;
+    std::string lines;
+    std::istringstream names(defines);
+    std::string name;
+    while (names >> name) lines += "#define " + name + "\n";
+    const size_t versionEnd = code.find('\n');
+    if (versionEnd == std::string::npos) return code + "\n" + lines;
+    return code.substr(0, versionEnd + 1) + lines + code.substr(versionEnd + 1);
+}
+
+// Replaces every line of the form #include "file" with that file's source, the path is relative to the including file.
+// Sources shared between stages (lighting.glsl) are kept in one place this way, GLSL has no include of its own.
+static std::string resolveIncludes(const std::string& code, const std::string& path, int depth = 0) {
+    const std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::istringstream lines(code);
+    std::string result;
+    std::string line;
+    while (std::getline(lines, line)) {
+        const size_t directive = line.find("#include");
+        const size_t open = line.find('"');
+        const size_t close = line.find('"', open + 1);
+        if (directive == std::string::npos || line.find_first_not_of(" \t") != directive || open == std::string::npos || close == std::string::npos) {
+            result += line + "\n";
+            continue;
+        }
+
+        const std::string includePath = directory + line.substr(open + 1, close - open - 1);
+        std::ifstream file(includePath);
+        if (!file || depth > 8) {
+            std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+            continue;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        result += resolveIncludes(stream.str(), includePath, depth + 1);
+    }
+    return result;
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const char* defines) {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -38,8 +86,10 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geo
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = addDefines(resolveIncludes(gShaderStream.str(), geometryPath), defines);
             }
+            vertexCode = addDefines(resolveIncludes(vertexCode, vertexPath), defines);
+            fragmentCode = addDefines(resolveIncludes(fragmentCode, fragmentPath), defines);
         }
         catch (std::ifstream::failure& e)
         {
@@ -77,6 +127,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geo
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        reflectUniforms();
+        bindUniformBlocks();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -86,23 +138,23 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geo
     }
 
 void Shader::use() {
-    glUseProgram(ID);
+    GLStateCache::get().useProgram(ID);
 }
 
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    set(getUniform(name), value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    set(getUniform(name), value);
 }
 
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    set(getUniform(name), value);
 }
 
 void Shader::setSampler2D(const std::string &name, unsigned int textureID) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), textureID);
+    set(getUniform(name), static_cast<int>(textureID));
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type) {
@@ -129,46 +181,183 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type) {
 }
 
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(getUniform(name), value);
 }
 
 
 void Shader::setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    set(getUniform(name), glm::vec2(x, y));
 }
 
 
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(getUniform(name), value);
 }
 
 
 void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    set(getUniform(name), glm::vec3(x, y, z));
 }
 
 
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(getUniform(name), value);
 }
 
 
 void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    set(getUniform(name), glm::vec4(x, y, z, w));
 }
 
 
 void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    set(getUniform(name), mat);
 }
 
 
 void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    set(getUniform(name), mat);
 }
 
 
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    set(getUniform(name), mat);
+}
+
+// Every active uniform is looked up once here. Arrays are reported once as "name[0]", so the other elements
+// get their own entries and the bare name shares element zero's. Members of struct arrays are reported one by one already.
+void Shader::reflectUniforms() {
+    uniforms.clear();
+    uniformIndices.clear();
+    shadow.clear();
+
+    int count = 0;
+    int maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer(std::max(maxLength, 1));
+    for (int i = 0; i < count; i++) {
+        int length = 0;
+        int size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, static_cast<GLsizei>(buffer.size()), &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), length);
+        // uniforms inside blocks have no location
+        const int location = glGetUniformLocation(ID, name.c_str());
+        if (location < 0) continue;
+
+        addUniform(name, location, type);
+        const size_t bracket = name.size() > 3 ? name.rfind("[0]") : std::string::npos;
+        if (bracket == std::string::npos || bracket != name.size() - 3) continue;
+
+        const std::string base = name.substr(0, bracket);
+        uniformIndices.emplace(base, uniformIndices.at(name));
+        for (int element = 1; element < size; element++) {
+            const std::string elementName = base + "[" + std::to_string(element) + "]";
+            addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()), type);
+        }
+    }
+}
+
+void Shader::bindUniformBlocks() {
+    static const std::pair<const char*, UniformBlockBinding> blocks[] = {
+        {"FrameUniforms", FRAME_UNIFORMS_BINDING},
+        {"LightUniforms", LIGHT_UNIFORMS_BINDING},
+        {"ClusterUniforms", CLUSTER_UNIFORMS_BINDING},
+    };
+    for (const auto& [name, binding] : blocks) {
+        const unsigned int index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(ID, index, binding);
+    }
+
+    static const std::pair<const char*, SharedTextureUnit> samplers[] = {
+        {"lightData", LIGHT_DATA_UNIT},
+        {"clusterGrid", CLUSTER_GRID_UNIT},
+        {"clusterLights", CLUSTER_LIGHTS_UNIT},
+    };
+    for (const auto& [name, unit] : samplers) {
+        const UniformHandle sampler = getUniform(name);
+        if (!sampler.isValid()) continue;
+        // the program isn't bound yet, keep the shadow copy in step by hand
+        const int value = static_cast<int>(unit);
+        glProgramUniform1i(ID, sampler.location, value);
+        Uniform& entry = uniforms[sampler.index];
+        std::memcpy(&shadow[entry.offset], &value, sizeof(value));
+        entry.written = true;
+    }
 }
 
+void Shader::addUniform(const std::string &name, int location, GLenum type) {
+    unsigned int size;
+    switch (type) {
+        case GL_FLOAT_VEC2: size = sizeof(glm::vec2); break;
+        case GL_FLOAT_VEC3: size = sizeof(glm::vec3); break;
+        case GL_FLOAT_VEC4: size = sizeof(glm::vec4); break;
+        case GL_FLOAT_MAT2: size = sizeof(glm::mat2); break;
+        case GL_FLOAT_MAT3: size = sizeof(glm::mat3); break;
+        case GL_FLOAT_MAT4: size = sizeof(glm::mat4); break;
+        // float, int, bool and samplers
+        default: size = sizeof(int); break;
+    }
+    uniformIndices.emplace(name, static_cast<int>(uniforms.size()));
+    uniforms.push_back({location, static_cast<unsigned int>(shadow.size()), size, false});
+    shadow.resize(shadow.size() + size);
+}
+
+UniformHandle Shader::getUniform(const std::string &name) const {
+    auto it = uniformIndices.find(name);
+    if (it == uniformIndices.end()) return {};
+    return {uniforms[it->second].location, it->second};
+}
+
+bool Shader::changed(UniformHandle uniform, const void* value, size_t size) const {
+    if (!uniform.isValid()) return false;
+    assert(GLStateCache::get().mayBeBound(ID) && "Shader::set() needs the program bound, call use() first");
+    Uniform& entry = uniforms[uniform.index];
+    // set as a different type than declared, GL reports that, nothing to compare against
+    if (size != entry.size) return true;
+    unsigned char* copy = &shadow[entry.offset];
+    if (entry.written && std::memcmp(copy, value, size) == 0) {
+        skippedUniforms++;
+        return false;
+    }
+    std::memcpy(copy, value, size);
+    entry.written = true;
+    return true;
+}
+
+void Shader::set(UniformHandle uniform, bool value) const {
+    set(uniform, static_cast<int>(value));
+}
+
+void Shader::set(UniformHandle uniform, int value) const {
+    if (changed(uniform, &value, sizeof(value))) glUniform1i(uniform.location, value);
+}
+
+void Shader::set(UniformHandle uniform, float value) const {
+    if (changed(uniform, &value, sizeof(value))) glUniform1f(uniform.location, value);
+}
+
+void Shader::set(UniformHandle uniform, const glm::vec2 &value) const {
+    if (changed(uniform, &value, sizeof(value))) glUniform2fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(UniformHandle uniform, const glm::vec3 &value) const {
+    if (changed(uniform, &value, sizeof(value))) glUniform3fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(UniformHandle uniform, const glm::vec4 &value) const {
+    if (changed(uniform, &value, sizeof(value))) glUniform4fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(UniformHandle uniform, const glm::mat2 &mat) const {
+    if (changed(uniform, &mat, sizeof(mat))) glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::set(UniformHandle uniform, const glm::mat3 &mat) const {
+    if (changed(uniform, &mat, sizeof(mat))) glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::set(UniformHandle uniform, const glm::mat4 &mat) const {
+    if (changed(uniform, &mat, sizeof(mat))) glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
@@ -8,14 +8,42 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Fixed binding points of the uniform blocks shared by all programs.
+enum UniformBlockBinding : unsigned int {
+    FRAME_UNIFORMS_BINDING = 0,
+    LIGHT_UNIFORMS_BINDING = 1,
+    CLUSTER_UNIFORMS_BINDING = 2,
+};
+
+// Texture units kept for buffers shared by all programs, above the ones meshes bind their textures to.
+enum SharedTextureUnit : unsigned int {
+    LIGHT_DATA_UNIT = 13,
+    CLUSTER_GRID_UNIT = 14,
+    CLUSTER_LIGHTS_UNIT = 15,
+};
+
+// Pre-resolved uniform of one shader, fetch it once with Shader::getUniform and keep it.
+// An invalid handle (a name the program doesn't use) makes the setters do nothing, like location -1 does in GL.
+struct UniformHandle {
+    int location = -1;
+    int index = -1;    // into the shader's uniform table
+
+    bool isValid() const {
+        return index >= 0;
+    }
+};
 
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
+    // defines are names separated by spaces, each one is #defined in every stage right after the #version line
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* defines = nullptr);
 
     // activate the shader
     // ------------------------------------------------------------------------
@@ -46,7 +74,51 @@ public:
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
 
+    // handle based setters, they skip the GL call when the value is the one the program already holds.
+    // They upload to the bound program, so use() has to come first: a set() while another program is bound
+    // would update the shadow copy and a later set() of the same value would skip the real upload.
+    // Debug builds assert on that.
+    // ------------------------------------------------------------------------
+    UniformHandle getUniform(const std::string &name) const;
+    void set(UniformHandle uniform, bool value) const;
+    void set(UniformHandle uniform, int value) const;
+    void set(UniformHandle uniform, float value) const;
+    void set(UniformHandle uniform, const glm::vec2 &value) const;
+    void set(UniformHandle uniform, const glm::vec3 &value) const;
+    void set(UniformHandle uniform, const glm::vec4 &value) const;
+    void set(UniformHandle uniform, const glm::mat2 &mat) const;
+    void set(UniformHandle uniform, const glm::mat3 &mat) const;
+    void set(UniformHandle uniform, const glm::mat4 &mat) const;
+
+    // GL calls skipped by every program because the shadow copy already held the value, since resetStats(),
+    // for the inspector
+    static inline size_t skippedUniforms = 0;
+
+    static void resetStats() {
+        skippedUniforms = 0;
+    }
+
 private:
+    struct Uniform {
+        int location;
+        unsigned int offset;    // into shadow
+        unsigned int size;      // bytes
+        bool written;
+    };
+
+    mutable std::vector<Uniform> uniforms;
+    std::unordered_map<std::string, int> uniformIndices;
+    // last value sent to every uniform, uniform state belongs to the program so nothing else can change it
+    mutable std::vector<unsigned char> shadow;
+
+    // fills the uniform table from the linked program
+    void reflectUniforms();
+    // points the shared blocks and samplers the program declares at their binding points and units
+    void bindUniformBlocks();
+    void addUniform(const std::string &name, int location, GLenum type);
+    // true when the value differs from the shadow copy, which is then updated
+    bool changed(UniformHandle uniform, const void* value, size_t size) const;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type);
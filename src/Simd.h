@@ -0,0 +1,241 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef SIMD_H
+#define SIMD_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__clang__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Minimal 4-wide float vector used by the transform kernels.
+// SSE on x86, NEON on Apple Silicon, plain floats everywhere else.
+namespace simd {
+
+#if SIMD_SSE
+    using float4 = __m128;
+
+    inline float4 load(const float* p) { return _mm_loadu_ps(p); }
+    inline void store(float* p, float4 v) { _mm_storeu_ps(p, v); }
+    inline float4 set(float x, float y, float z, float w) { return _mm_set_ps(w, z, y, x); }
+    inline float4 splat(float v) { return _mm_set1_ps(v); }
+    inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+    inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+    inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    template<int X, int Y, int Z, int W>
+    inline float4 shuffle(float4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X)); }
+    template<int Lane>
+    inline float4 splatLane(float4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Lane, Lane, Lane, Lane)); }
+    // lane masks: compare results combined with maskAnd, read back as one bit per lane
+    inline float4 cmpge(float4 a, float4 b) { return _mm_cmpge_ps(a, b); }
+    inline float4 maskAnd(float4 a, float4 b) { return _mm_and_ps(a, b); }
+    inline int moveMask(float4 m) { return _mm_movemask_ps(m); }
+    inline float4 max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+    // lanes of a where the mask is set, b elsewhere
+    inline float4 select(float4 mask, float4 a, float4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    inline float4 div(float4 a, float4 b) { return _mm_div_ps(a, b); }
+    inline float4 sqrt(float4 v) { return _mm_sqrt_ps(v); }
+    // rows become columns
+    inline void transpose(float4& a, float4& b, float4& c, float4& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+#elif SIMD_NEON
+    using float4 = float32x4_t;
+
+    inline float4 load(const float* p) { return vld1q_f32(p); }
+    inline void store(float* p, float4 v) { vst1q_f32(p, v); }
+    inline float4 set(float x, float y, float z, float w) { float v[4] = {x, y, z, w}; return vld1q_f32(v); }
+    inline float4 splat(float v) { return vdupq_n_f32(v); }
+    inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+    inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+    inline float4 madd(float4 a, float4 b, float4 c) { return vfmaq_f32(c, a, b); }
+    template<int X, int Y, int Z, int W>
+    inline float4 shuffle(float4 v) { return __builtin_shufflevector(v, v, X, Y, Z, W); }
+    template<int Lane>
+    inline float4 splatLane(float4 v) { return vdupq_laneq_f32(v, Lane); }
+    inline float4 cmpge(float4 a, float4 b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+    inline float4 maskAnd(float4 a, float4 b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    inline int moveMask(float4 m) {
+        uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(m), 31);
+        return vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) | (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3);
+    }
+    inline float4 max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+    inline float4 select(float4 mask, float4 a, float4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+    inline float4 div(float4 a, float4 b) { return vdivq_f32(a, b); }
+    inline float4 sqrt(float4 v) { return vsqrtq_f32(v); }
+    inline void transpose(float4& a, float4& b, float4& c, float4& d) {
+        const float32x4x2_t ab = vtrnq_f32(a, b);
+        const float32x4x2_t cd = vtrnq_f32(c, d);
+        a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+        b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+        c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+        d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+    }
+#else
+    struct float4 { float v[4]; };
+
+    inline float4 load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+    inline void store(float* p, float4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+    inline float4 set(float x, float y, float z, float w) { return {{x, y, z, w}}; }
+    inline float4 splat(float s) { return {{s, s, s, s}}; }
+    inline float4 add(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+    inline float4 mul(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+    inline float4 madd(float4 a, float4 b, float4 c) { for (int i = 0; i < 4; i++) c.v[i] += a.v[i] * b.v[i]; return c; }
+    template<int X, int Y, int Z, int W>
+    inline float4 shuffle(float4 a) { return {{a.v[X], a.v[Y], a.v[Z], a.v[W]}}; }
+    template<int Lane>
+    inline float4 splatLane(float4 a) { return splat(a.v[Lane]); }
+    // masks are 1.0 / 0.0 per lane here
+    inline float4 cmpge(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] >= b.v[i] ? 1.0f : 0.0f; return a; }
+    inline float4 maskAnd(float4 a, float4 b) { return mul(a, b); }
+    inline int moveMask(float4 m) { int bits = 0; for (int i = 0; i < 4; i++) bits |= (m.v[i] != 0.0f) << i; return bits; }
+    inline float4 max(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+    inline float4 select(float4 mask, float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i]; return a; }
+    inline float4 div(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] /= b.v[i]; return a; }
+    inline float4 sqrt(float4 a) { for (int i = 0; i < 4; i++) a.v[i] = std::sqrt(a.v[i]); return a; }
+    inline void transpose(float4& a, float4& b, float4& c, float4& d) {
+        float4* rows[4] = {&a, &b, &c, &d};
+        for (int i = 0; i < 4; i++) {
+            for (int j = i + 1; j < 4; j++) std::swap(rows[i]->v[j], rows[j]->v[i]);
+        }
+    }
+#endif
+
+    // out = translate(t) * mat4_cast(q) * scale(s), built column by column straight from the quaternion
+    // instead of multiplying separate translation, rotation and scale matrices.
+    inline void composeTRS(const glm::vec3& t, const glm::quat& q, const glm::vec3& s, glm::mat4& out) {
+        // glm stores quaternions as x, y, z, w
+        const float4 r = set(q.x, q.y, q.z, q.w);
+        const float4 two = splat(2.0f);
+
+        // column 0: 1 - 2(yy + zz), 2(xy + wz), 2(xz - wy)
+        float4 a = mul(mul(shuffle<1, 0, 0, 3>(r), shuffle<1, 1, 2, 3>(r)), two);
+        float4 b = mul(mul(shuffle<2, 3, 3, 3>(r), shuffle<2, 2, 1, 3>(r)), two);
+        float4 c0 = madd(b, set(-1.0f, 1.0f, -1.0f, 0.0f), madd(a, set(-1.0f, 1.0f, 1.0f, 0.0f), set(1.0f, 0.0f, 0.0f, 0.0f)));
+
+        // column 1: 2(xy - wz), 1 - 2(xx + zz), 2(yz + wx)
+        a = mul(mul(shuffle<0, 0, 1, 3>(r), shuffle<1, 0, 2, 3>(r)), two);
+        b = mul(mul(shuffle<3, 2, 3, 3>(r), shuffle<2, 2, 0, 3>(r)), two);
+        float4 c1 = madd(b, set(-1.0f, -1.0f, 1.0f, 0.0f), madd(a, set(1.0f, -1.0f, 1.0f, 0.0f), set(0.0f, 1.0f, 0.0f, 0.0f)));
+
+        // column 2: 2(xz + wy), 2(yz - wx), 1 - 2(xx + yy)
+        a = mul(mul(shuffle<0, 1, 0, 3>(r), shuffle<2, 2, 0, 3>(r)), two);
+        b = mul(mul(shuffle<3, 3, 1, 3>(r), shuffle<1, 0, 1, 3>(r)), two);
+        float4 c2 = madd(b, set(1.0f, -1.0f, -1.0f, 0.0f), madd(a, set(1.0f, 1.0f, -1.0f, 0.0f), set(0.0f, 0.0f, 1.0f, 0.0f)));
+
+        float* m = &out[0][0];
+        store(m, mul(c0, splat(s.x)));
+        store(m + 4, mul(c1, splat(s.y)));
+        store(m + 8, mul(c2, splat(s.z)));
+        store(m + 12, set(t.x, t.y, t.z, 1.0f));
+    }
+
+    // out = a * b for column-major matrices. out may alias a or b.
+    inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+        const float* pa = &a[0][0];
+        const float4 a0 = load(pa);
+        const float4 a1 = load(pa + 4);
+        const float4 a2 = load(pa + 8);
+        const float4 a3 = load(pa + 12);
+
+        for (int col = 0; col < 4; col++) {
+            const float4 bc = load(&b[col][0]);
+            float4 r = mul(a0, splatLane<0>(bc));
+            r = madd(a1, splatLane<1>(bc), r);
+            r = madd(a2, splatLane<2>(bc), r);
+            r = madd(a3, splatLane<3>(bc), r);
+            store(&out[col][0], r);
+        }
+    }
+
+    // The top three rows of an affine matrix, 12 floats. The bottom row is always 0, 0, 0, 1.
+    inline void packAffine(const glm::mat4& m, float* out) {
+        const float* p = &m[0][0];
+        float4 c0 = load(p);
+        float4 c1 = load(p + 4);
+        float4 c2 = load(p + 8);
+        float4 c3 = load(p + 12);
+        transpose(c0, c1, c2, c3);
+        store(out, c0);
+        store(out + 4, c1);
+        store(out + 8, c2);
+    }
+
+    // Splits a matrix made of translation, rotation and uniform scale. The rotation comes out as a unit quaternion
+    // in 16 bit snorm, x, y, z, w, with w >= 0. A non-uniform scale is replaced by the longest axis, shear is lost.
+    inline void packQuaternion(const glm::mat4& m, glm::vec3& position, float& scale, int16_t* rotation) {
+        const float* p = &m[0][0];
+        float4 r0 = load(p);
+        float4 r1 = load(p + 4);
+        float4 r2 = load(p + 8);
+        float4 r3 = load(p + 12);
+        transpose(r0, r1, r2, r3);
+
+        // lanes hold the axes: squared lengths, then rows of the pure rotation
+        const float4 axes = sqrt(madd(r0, r0, madd(r1, r1, mul(r2, r2))));
+        const float4 inverse = div(splat(1.0f), max(axes, splat(1e-20f)));
+        r0 = mul(r0, inverse);
+        r1 = mul(r1, inverse);
+        r2 = mul(r2, inverse);
+
+        // 4x^2, 4y^2, 4z^2, 4w^2 from the diagonal
+        float4 t = madd(splatLane<0>(r0), set(1.0f, -1.0f, -1.0f, 1.0f), splat(1.0f));
+        t = madd(splatLane<1>(r1), set(-1.0f, 1.0f, -1.0f, 1.0f), t);
+        t = madd(splatLane<2>(r2), set(-1.0f, -1.0f, 1.0f, 1.0f), t);
+
+        float rows[3][4];
+        float lengths[4];
+        float squares[4];
+        store(rows[0], r0);
+        store(rows[1], r1);
+        store(rows[2], r2);
+        store(lengths, axes);
+        store(squares, t);
+
+        // The largest component comes from its square, the others from off-diagonal sums and differences divided by it.
+        // Taking the others' signs from the differences alone breaks down near 180 degrees, where w goes to 0.
+        int largest = 3;
+        for (int i = 0; i < 3; i++) {
+            if (squares[i] > squares[largest]) largest = i;
+        }
+        const float root = 0.5f * std::sqrt(std::max(squares[largest], 1e-20f));
+        const float f = 0.25f / root;
+        const float xw = (rows[2][1] - rows[1][2]) * f;
+        const float yw = (rows[0][2] - rows[2][0]) * f;
+        const float zw = (rows[1][0] - rows[0][1]) * f;
+        const float xy = (rows[0][1] + rows[1][0]) * f;
+        const float xz = (rows[0][2] + rows[2][0]) * f;
+        const float yz = (rows[1][2] + rows[2][1]) * f;
+        float quaternion[4];
+        switch (largest) {
+            case 0: quaternion[0] = root; quaternion[1] = xy; quaternion[2] = xz; quaternion[3] = xw; break;
+            case 1: quaternion[0] = xy; quaternion[1] = root; quaternion[2] = yz; quaternion[3] = yw; break;
+            case 2: quaternion[0] = xz; quaternion[1] = yz; quaternion[2] = root; quaternion[3] = zw; break;
+            default: quaternion[0] = xw; quaternion[1] = yw; quaternion[2] = zw; quaternion[3] = root; break;
+        }
+        // q and -q are the same rotation, keep w non-negative so equal rotations pack to equal bits
+        if (quaternion[3] < 0.0f) {
+            for (float& component : quaternion) component = -component;
+        }
+
+        // renormalized so the rounding spreads over all four
+        const float norm = std::sqrt(1e-20f + quaternion[0] * quaternion[0] + quaternion[1] * quaternion[1] +
+                                     quaternion[2] * quaternion[2] + quaternion[3] * quaternion[3]);
+        for (int i = 0; i < 4; i++) {
+            rotation[i] = static_cast<int16_t>(std::lround(quaternion[i] / norm * 32767.0f));
+        }
+        position = glm::vec3(m[3]);
+        scale = std::max(lengths[0], std::max(lengths[1], lengths[2]));
+    }
+}
+
+#endif //SIMD_H
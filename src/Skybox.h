@@ -10,6 +10,8 @@
 #include <glad/glad.h>
 #include "stb_image.h"
 
+#include "GLStateCache.h"
+
 class Skybox {
 
 private:
@@ -27,7 +29,7 @@ private:
         stbi_set_flip_vertically_on_load(false);
         unsigned int textureID;
         glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        GLStateCache::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
         int width, height, nrChannels;
         for (unsigned int i = 0; i < faces.size(); i++)
@@ -103,8 +105,8 @@ private:
         };
         glGenVertexArrays(1, &skyboxVAO);
         glGenBuffers(1, &skyboxVBO);
-        glBindVertexArray(skyboxVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+        GLStateCache::get().bindVertexArray(skyboxVAO);
+        GLStateCache::get().bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -124,17 +126,16 @@ public:
     };
 
 
-    void Draw(glm::mat4 viewMatrix) {
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+    // view and projection come from the FrameUniforms block, the shader drops the translation
+    void Draw() {
+        GLStateCache& state = GLStateCache::get();
+        state.depthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         shader->use();
-        shader->setMat4("view", viewMatrix);
         // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        state.bindVertexArray(skyboxVAO);
+        state.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
+        state.depthFunc(GL_LESS); // set depth function back to default
     }
 
     unsigned int& getCubemapTexture() { return cubemapTexture; }
@@ -0,0 +1,90 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef SLABARENA_H
+#define SLABARENA_H
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Fixed-size block allocator. Memory comes in slabs of many blocks and freed blocks go on an
+// intrusive free list, so allocating a block is a pointer pop instead of a trip to the heap.
+// Not thread safe; scene nodes are only created and destroyed on the main thread.
+class SlabArena {
+public:
+    SlabArena(size_t blockSize, size_t alignment, size_t blocksPerSlab = 1024)
+    : alignment(std::max(alignment, alignof(FreeBlock))),
+      blocksPerSlab(blocksPerSlab) {
+        // every block has to fit the free list link and keep the next block aligned
+        this->blockSize = std::max(blockSize, sizeof(FreeBlock));
+        this->blockSize = (this->blockSize + this->alignment - 1) / this->alignment * this->alignment;
+    }
+
+    ~SlabArena() {
+        for (void* slab : slabs) {
+            ::operator delete(slab, std::align_val_t(alignment));
+        }
+    }
+
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    void* allocate() {
+        if (!freeList) grow(blocksPerSlab);
+        FreeBlock* block = freeList;
+        freeList = block->next;
+        liveCount++;
+        return block;
+    }
+
+    void deallocate(void* p) {
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = freeList;
+        freeList = block;
+        liveCount--;
+    }
+
+    // makes sure the next count allocations do not have to grow
+    void reserve(size_t count) {
+        const size_t available = capacity - liveCount;
+        if (available < count) grow(std::max(blocksPerSlab, count - available));
+    }
+
+    size_t size() const {
+        return liveCount;
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    size_t blockSize;
+    size_t alignment;
+    size_t blocksPerSlab;
+    size_t liveCount = 0;
+    size_t capacity = 0;
+    FreeBlock* freeList = nullptr;
+    std::vector<void*> slabs;
+
+    void grow(size_t blockCount) {
+        char* slab = static_cast<char*>(::operator new(blockCount * blockSize, std::align_val_t(alignment)));
+        slabs.push_back(slab);
+        capacity += blockCount;
+
+        // link back to front so blocks are handed out in address order
+        for (size_t i = blockCount; i-- > 0;) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + i * blockSize);
+            block->next = freeList;
+            freeList = block;
+        }
+    }
+};
+
+#endif //SLABARENA_H
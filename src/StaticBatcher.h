@@ -0,0 +1,272 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef STATICBATCHER_H
+#define STATICBATCHER_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "EntityRegistry.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "Node.h"
+#include "TransformStore.h"
+
+// Merges the meshes of nodes that don't move into world space geometry, one mesh per material and texture set
+// in each cell of a coarse grid, so set dressing costs a few draws per visible chunk instead of one per mesh.
+// The cells keep frustum and occlusion culling meaningful.
+//
+// A node qualifies when it has a model, no light or instance of any kind, is visible, and it and every ancestor
+// are stationary. Showing or hiding any node through setVisible() collects the members again.
+// Stationary nodes can still be moved by the animator or from the Inspector, so changes are watched:
+// a chunk is rebuilt when one of its nodes is edited, and a node that changes on two frames in a row
+// is animated and drawn on its own again until it has been still for REJOIN_FRAMES.
+// Batches always draw the full detail level.
+class StaticBatcher {
+public:
+    static constexpr float CHUNK_SIZE = 64.0f;
+    static constexpr uint32_t REJOIN_FRAMES = 120;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Batch {
+        Material material;
+        std::unique_ptr<Mesh> mesh;
+    };
+
+    struct Chunk {
+        glm::ivec3 cell;
+        AABB bounds;
+        std::vector<Entity> members;
+        std::vector<Batch> batches;
+        bool dirty = false;
+    };
+
+    bool enabled = true;
+
+    // for the inspector
+    size_t rebuiltChunks = 0;     // since the start
+    size_t batchedTriangles = 0;
+
+    // the model matrix of every batch, the vertices are already in world space
+    static inline const glm::mat4 IDENTITY = glm::mat4(1.0f);
+
+    // Picks up new, removed and edited nodes. Call after the TransformStore update.
+    void update() {
+        frame++;
+        EntityRegistry& registry = EntityRegistry::get();
+        const uint32_t version = registry.pool<Renderable>().version + registry.pool<Animated>().version +
+                                 registry.pool<LightComponent>().version + registry.pool<InstanceComponent>().version +
+                                 registry.pool<PrefabComponent>().version + Node::visibilityVersion;
+        if (version != builtVersion) {
+            build();
+            builtVersion = version;
+            rebuildDirty();
+            return;
+        }
+
+        TransformStore& store = TransformStore::get();
+        for (uint32_t s : store.changedFlagged) {
+            if (!(store.flags[s] & TransformStore::BOUNDED) || !store.owners[s]) continue;
+            const Entity entity = store.owners[s]->getId();
+            const uint32_t chunk = chunkOf(entity);
+            const bool wasEjected = ejected.count(entity) > 0;
+            if (chunk == NONE && !wasEjected) continue;
+
+            auto last = lastChange.find(entity);
+            const bool animated = last != lastChange.end() && last->second + 1 == frame;
+            lastChange[entity] = frame;
+            if (chunk == NONE) continue;
+
+            removeMember(entity);
+            if (animated) ejected.insert(entity);
+            else addMember(entity);
+        }
+
+        for (auto it = ejected.begin(); it != ejected.end();) {
+            if (frame - lastChange[*it] > REJOIN_FRAMES) {
+                const Entity entity = *it;
+                it = ejected.erase(it);
+                if (qualifies(entity)) addMember(entity);
+            } else {
+                ++it;
+            }
+        }
+        rebuildDirty();
+    }
+
+    // The node's geometry or material changed outside of its transform, rebuilds its chunk.
+    void invalidate(Entity entity) {
+        const uint32_t chunk = chunkOf(entity);
+        if (chunk != NONE) chunks[chunk].dirty = true;
+    }
+
+    // true when the entity is drawn as part of a batch
+    bool isBatched(Entity entity) const {
+        return enabled && chunkOf(entity) != NONE;
+    }
+
+    const std::vector<Chunk>& getChunks() const {
+        return chunks;
+    }
+
+    size_t batchedCount() const {
+        return memberCount;
+    }
+
+    size_t ejectedCount() const {
+        return ejected.size();
+    }
+
+private:
+    std::vector<Chunk> chunks;
+    std::unordered_map<uint64_t, uint32_t> chunkOfCell;
+    std::vector<uint32_t> entityChunks;     // entity -> chunk, NONE when not batched
+    std::unordered_map<Entity, uint32_t> lastChange;    // frame of the last transform change
+    std::unordered_set<Entity> ejected;                 // animated nodes, drawn on their own
+    size_t memberCount = 0;
+    uint32_t builtVersion = UINT32_MAX;
+    uint32_t frame = 0;
+
+    uint32_t chunkOf(Entity entity) const {
+        return entity < entityChunks.size() ? entityChunks[entity] : NONE;
+    }
+
+    bool qualifies(Entity entity) const {
+        EntityRegistry& registry = EntityRegistry::get();
+        Renderable* renderable = registry.find<Renderable>(entity);
+        if (!renderable || !renderable->model || renderable->model->meshes.empty()) return false;
+        if (registry.find<LightComponent>(entity) || registry.find<InstanceComponent>(entity) || registry.find<PrefabComponent>(entity)) return false;
+        const Node* node = Node::findById(entity);
+        if (!node || !node->isVisibleInHierarchy()) return false;
+        for (const Node* n = node; n != nullptr; n = n->parent) {
+            if (!n->isStationary()) return false;
+        }
+        return true;
+    }
+
+    // Collects every qualifying node again. Chunks and their buffers are kept for reuse.
+    void build() {
+        for (Chunk& chunk : chunks) {
+            chunk.members.clear();
+            chunk.dirty = true;
+        }
+        std::fill(entityChunks.begin(), entityChunks.end(), NONE);
+        memberCount = 0;
+
+        EntityRegistry::get().view<Renderable, TransformComponent>().each([&](Entity entity, Renderable&, TransformComponent&) {
+            if (ejected.count(entity) == 0 && qualifies(entity)) addMember(entity);
+        });
+    }
+
+    void addMember(Entity entity) {
+        TransformStore& store = TransformStore::get();
+        const TransformComponent& transform = *EntityRegistry::get().find<TransformComponent>(entity);
+        const glm::vec3 center = glm::vec3(store.worldMatrices[store.slot(transform.handle)][3]);
+        const glm::ivec3 cell = glm::ivec3(glm::floor(center / CHUNK_SIZE));
+        const uint64_t key = (static_cast<uint64_t>(cell.x & 0x1FFFFF) << 42) | (static_cast<uint64_t>(cell.y & 0x1FFFFF) << 21) | static_cast<uint64_t>(cell.z & 0x1FFFFF);
+
+        auto it = chunkOfCell.find(key);
+        uint32_t chunk;
+        if (it == chunkOfCell.end()) {
+            chunk = static_cast<uint32_t>(chunks.size());
+            chunks.emplace_back();
+            chunks.back().cell = cell;
+            chunkOfCell.emplace(key, chunk);
+        } else {
+            chunk = it->second;
+        }
+
+        if (entity >= entityChunks.size()) entityChunks.resize(entity + 1, NONE);
+        entityChunks[entity] = chunk;
+        chunks[chunk].members.push_back(entity);
+        chunks[chunk].dirty = true;
+        memberCount++;
+    }
+
+    void removeMember(Entity entity) {
+        const uint32_t chunk = chunkOf(entity);
+        if (chunk == NONE) return;
+        std::vector<Entity>& members = chunks[chunk].members;
+        members.erase(std::find(members.begin(), members.end(), entity));
+        entityChunks[entity] = NONE;
+        chunks[chunk].dirty = true;
+        memberCount--;
+    }
+
+    void rebuildDirty() {
+        batchedTriangles = 0;
+        for (Chunk& chunk : chunks) {
+            if (chunk.dirty) {
+                rebuild(chunk);
+                chunk.dirty = false;
+                rebuiltChunks++;
+            }
+            for (const Batch& batch : chunk.batches) {
+                batchedTriangles += batch.mesh->indices.size() / 3;
+            }
+        }
+    }
+
+    // Transforms the full detail level of every member mesh into world space, appended into the batch
+    // for its material and texture set. Batches that end up empty keep their buffers for later.
+    void rebuild(Chunk& chunk) {
+        struct Geometry {
+            std::vector<Vertex> vertices;
+            std::vector<unsigned int> indices;
+        };
+        std::vector<Geometry> merged(chunk.batches.size());
+        chunk.bounds = AABB();
+
+        EntityRegistry& registry = EntityRegistry::get();
+        TransformStore& store = TransformStore::get();
+        for (Entity entity : chunk.members) {
+            const Renderable& renderable = *registry.find<Renderable>(entity);
+            const TransformComponent& transform = *registry.find<TransformComponent>(entity);
+            const glm::mat4& world = store.worldMatrices[store.slot(transform.handle)];
+            const glm::mat3 basis = glm::mat3(world);
+            const glm::mat3 normalMatrix = glm::transpose(glm::inverse(basis));
+
+            for (const Mesh& mesh : renderable.model->meshes) {
+                size_t index = 0;
+                while (index < chunk.batches.size() && (chunk.batches[index].material != renderable.material ||
+                                                         chunk.batches[index].mesh->textureSet != mesh.textureSet)) {
+                    index++;
+                }
+                if (index == chunk.batches.size()) {
+                    chunk.batches.push_back({renderable.material, std::make_unique<Mesh>(mesh.textures)});
+                    merged.emplace_back();
+                }
+
+                Geometry& geometry = merged[index];
+                const unsigned int base = static_cast<unsigned int>(geometry.vertices.size());
+                for (Vertex vertex : mesh.vertices) {
+                    vertex.position = glm::vec3(world * glm::vec4(vertex.position, 1.0f));
+                    vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+                    vertex.tangent = basis * vertex.tangent;
+                    vertex.biTangent = basis * vertex.biTangent;
+                    geometry.vertices.push_back(vertex);
+                    chunk.bounds.expand(vertex.position);
+                }
+                const MeshLod& full = mesh.getLod(0);
+                const unsigned int* indices = mesh.getLodIndices(0);
+                for (unsigned int i = 0; i < full.indexCount; i++) {
+                    geometry.indices.push_back(base + indices[i]);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < chunk.batches.size(); i++) {
+            chunk.batches[i].mesh->upload(std::move(merged[i].vertices), std::move(merged[i].indices));
+        }
+    }
+};
+
+#endif //STATICBATCHER_H
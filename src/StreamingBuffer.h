@@ -0,0 +1,188 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef STREAMINGBUFFER_H
+#define STREAMINGBUFFER_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "GLStateCache.h"
+
+// Buffer for data that is written again every frame. Writes never touch storage the GPU may still be reading,
+// so the driver doesn't have to stall or copy behind our back.
+//
+// RING keeps FRAMES regions in one buffer and hands out aligned pieces of the current frame's region.
+// Before a region is reused the CPU waits on the fence put down after the frame that last used it,
+// which only blocks when the GPU is more than FRAMES - 1 frames behind. Data is read at its offset:
+// vertex attribute pointers, glBindBufferRange or a copy into another buffer.
+// ORPHAN hands the old storage over to the driver on the first write of a frame and starts again at 0.
+// It's meant for texture buffers, GL 4.1 has no glTexBufferRange so they can only read from the start.
+//
+// GL 4.1 has no persistent mapping, each allocation is mapped unsynchronized and unmapped again.
+// Running out of room reallocates the buffer, allocations made earlier in the frame are lost,
+// so use an allocation before making the next one.
+class StreamingBuffer {
+public:
+    static constexpr int FRAMES = 3;
+
+    enum Mode {
+        RING,
+        ORPHAN,
+    };
+
+    struct Allocation {
+        size_t offset = 0;      // bytes into the buffer
+        void* data = nullptr;   // mapped, write-only until unmap()
+    };
+
+    // over every streaming buffer, for the inspector
+    static inline size_t waitCount = 0;       // since the start, times the CPU had to wait for the GPU
+    static inline size_t growCount = 0;       // since the start
+    static inline size_t streamedBytes = 0;   // in the last finished frame
+
+    void create(GLenum target, size_t frameCapacity, Mode mode = RING) {
+        this->target = target;
+        this->mode = mode;
+        if (!uniformAlignment) {
+            GLint alignment = 0;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            uniformAlignment = std::max<size_t>(16, alignment);
+        }
+        regionSize = alignUp(std::max<size_t>(frameCapacity, 1), REGION_ALIGNMENT);
+        glGenBuffers(1, &buffer);
+        GLStateCache::get().bindBuffer(target, buffer);
+        glBufferData(target, storageSize(), nullptr, GL_STREAM_DRAW);
+        bufferFrame = frame - 1;
+    }
+
+    // Maps bytes of this frame's space, aligned to alignment bytes. Call unmap() before drawing with it.
+    Allocation map(size_t bytes, size_t alignment = 16) {
+        if (bufferFrame != frame) beginFrame();
+
+        size_t offset = alignUp(head, alignment);
+        if (offset + bytes > regionBegin() + regionSize) {
+            grow(bytes + alignment);
+            offset = alignUp(head, alignment);
+        }
+        head = offset + bytes;
+        frameBytes += bytes;
+
+        Allocation allocation;
+        allocation.offset = offset;
+        if (bytes == 0) return allocation;
+        GLStateCache::get().bindBuffer(target, buffer);
+        allocation.data = glMapBufferRange(target, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!allocation.data && !mapFailed) {
+            // callers skip a null allocation, once in the log is enough
+            spdlog::error("Failed to map {} bytes of a streaming buffer, the data is dropped.", bytes);
+            mapFailed = true;
+        }
+        mapped = allocation.data != nullptr;
+        return allocation;
+    }
+
+    void unmap() {
+        if (!mapped) return;
+        GLStateCache::get().bindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        mapped = false;
+    }
+
+    // Copies the data into this frame's space, returns its offset.
+    size_t write(const void* data, size_t bytes, size_t alignment = 16) {
+        Allocation allocation = map(bytes, alignment);
+        if (allocation.data) std::memcpy(allocation.data, data, bytes);
+        unmap();
+        return allocation.offset;
+    }
+
+    unsigned int getBuffer() const {
+        return buffer;
+    }
+
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, valid after the first create()
+    static size_t getUniformAlignment() {
+        return uniformAlignment;
+    }
+
+    // Puts down the fence for everything drawn this frame. Call once, after the last draw of the frame.
+    static void nextFrame() {
+        GLsync& fence = fences[frame % FRAMES];
+        if (fence) glDeleteSync(fence);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        streamedBytes = frameBytes;
+        frameBytes = 0;
+        frame++;
+    }
+
+private:
+    // a multiple of every alignment allocations ask for, so each region starts aligned
+    static constexpr size_t REGION_ALIGNMENT = 256;
+
+    static inline GLsync fences[FRAMES] = {};
+    static inline uint64_t frame = 0;
+    static inline size_t frameBytes = 0;
+    static inline size_t uniformAlignment = 0;
+
+    GLenum target = GL_ARRAY_BUFFER;
+    Mode mode = RING;
+    unsigned int buffer = 0;
+    size_t regionSize = 0;
+    size_t head = 0;
+    uint64_t bufferFrame = 0;
+    bool mapped = false;
+    bool mapFailed = false;    // a failed map was already logged
+
+    static size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    size_t storageSize() const {
+        return mode == RING ? regionSize * FRAMES : regionSize;
+    }
+
+    size_t regionBegin() const {
+        return mode == RING ? (frame % FRAMES) * regionSize : 0;
+    }
+
+    void beginFrame() {
+        bufferFrame = frame;
+        head = regionBegin();
+        if (mode == RING) {
+            waitFor(fences[frame % FRAMES]);
+        } else {
+            GLStateCache::get().bindBuffer(target, buffer);
+            glBufferData(target, storageSize(), nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    // The fence is shared by every buffer, the first one to get past it deletes it.
+    static void waitFor(GLsync& fence) {
+        if (!fence) return;
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            waitCount++;
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // New storage isn't used by anything yet, the frame starts over at the beginning of its region.
+    void grow(size_t bytes) {
+        regionSize = alignUp(std::max(regionSize * 2, bytes), REGION_ALIGNMENT);
+        GLStateCache::get().bindBuffer(target, buffer);
+        glBufferData(target, storageSize(), nullptr, GL_STREAM_DRAW);
+        head = regionBegin();
+        growCount++;
+    }
+};
+
+#endif //STREAMINGBUFFER_H
@@ -0,0 +1,142 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pops its own tasks from the back and steals from the front of the others.
+// The thread calling wait() helps running tasks until everything submitted so far is done.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+        // queue 0 belongs to whichever thread is not a worker (usually the main thread)
+        for (unsigned i = 0; i <= threadCount; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 1; i <= threadCount; i++) {
+            threads.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // number of threads that can run tasks, including the one calling wait()
+    unsigned size() const {
+        return static_cast<unsigned>(threads.size()) + 1;
+    }
+
+    void submit(std::function<void()> task) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        queued.fetch_add(1, std::memory_order_relaxed);
+
+        size_t target = workerIndex;
+        if (workerIndex == 0 && !threads.empty()) {
+            // spread work coming from outside over the workers
+            target = 1 + nextQueue++ % threads.size();
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished, running tasks on the calling thread meanwhile.
+    void wait() {
+        while (pending.load(std::memory_order_acquire) > 0) {
+            if (!runOne(workerIndex)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct Queue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> pending{0};   // submitted but not finished
+    std::atomic<size_t> queued{0};    // submitted but not picked up yet
+    size_t nextQueue = 0;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    static inline thread_local size_t workerIndex = 0;
+
+    bool pop(size_t self, std::function<void()>& task) {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.tasks.empty()) return false;
+        task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool steal(size_t self, std::function<void()>& task) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne(size_t self) {
+        std::function<void()> task;
+        if (!pop(self, task) && !steal(self, task)) return false;
+        task();
+        pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        workerIndex = index;
+        while (true) {
+            if (runOne(index)) continue;
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (stopping) return;
+            // the timeout covers a notify that lands between runOne() and wait_for()
+            wake.wait_for(lock, std::chrono::milliseconds(1), [this] {
+                return stopping || queued.load(std::memory_order_relaxed) > 0;
+            });
+            if (stopping) return;
+        }
+    }
+};
+
+#endif //THREADPOOL_H
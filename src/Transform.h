@@ -4,111 +4,157 @@
 
 #ifndef TRANSFORM_H
 #define TRANSFORM_H
+#include "TransformStore.h"
 
+// Handle to a slot in the TransformStore. Local TRS and the world matrix live in the store's flat arrays.
 class Transform {
 public:
-    glm::vec3 position = glm::vec3(0, 0, 0);
-    glm::vec3 eulerRotation = glm::vec3(0, 0, 0);
-    glm::vec3 scale = glm::vec3(1, 1, 1);
+    Transform() : handle(TransformStore::get().create()) {
+    }
 
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    Transform(const Transform& other) : handle(TransformStore::get().create()) {
+        copyLocal(other);
+    }
 
-    glm::vec3 globalPosition = glm::vec3(0.0f);
+    Transform& operator=(const Transform& other) {
+        if (this != &other) copyLocal(other);
+        return *this;
+    }
 
-    //Dirty flag
-    bool m_isDirty = true;
+    ~Transform() {
+        TransformStore::get().release(handle);
+    }
 
-    glm::mat4 getLocalModelMatrix()
-    {
-        const glm::mat4 transformX = glm::rotate(glm::mat4(1.0f),
-                    glm::radians(eulerRotation.x),
-                    glm::vec3(1.0f, 0.0f, 0.0f));
-        const glm::mat4 transformY = glm::rotate(glm::mat4(1.0f),
-                    glm::radians(eulerRotation.y),
-                    glm::vec3(0.0f, 1.0f, 0.0f));
-        const glm::mat4 transformZ = glm::rotate(glm::mat4(1.0f),
-                    glm::radians(eulerRotation.z),
-                    glm::vec3(0.0f, 0.0f, 1.0f));
+    TransformStore::Handle getHandle() const {
+        return handle;
+    }
 
-        // Y * X * Z
-        const glm::mat4 rotationMatrix = transformY * transformX * transformZ;
+    void setParent(const Transform* parent) {
+        TransformStore::get().setParent(handle, parent ? parent->handle : TransformStore::INVALID);
+    }
 
-        // translation * rotation * scale (also know as TRS matrix)
-        return glm::translate(glm::mat4(1.0f), position) *
-                    rotationMatrix *
-                    glm::scale(glm::mat4(1.0f), scale);
+    // cached TRS matrix, rebuilt only if the local position, rotation or scale changed
+    const glm::mat4& getLocalModelMatrix()
+    {
+        TransformStore& store = TransformStore::get();
+        uint32_t s = store.slot(handle);
+        if (store.dirty[s]) {
+            simd::composeTRS(store.positions[s], store.rotations[s], store.scales[s], store.localMatrices[s]);
+        }
+        return store.localMatrices[s];
     }
 
 
     void computeModelMatrix()
     {
-        modelMatrix = getLocalModelMatrix();
-        m_isDirty = false;
+        TransformStore& store = TransformStore::get();
+        uint32_t s = store.slot(handle);
+        store.worldMatrices[s] = getLocalModelMatrix();
+        store.dirty[s] = 0;
     }
 
     void computeModelMatrix(const glm::mat4& parentGlobalModelMatrix)
     {
-        modelMatrix = parentGlobalModelMatrix * getLocalModelMatrix();
-        m_isDirty = false;
-        globalPosition = glm::vec3(parentGlobalModelMatrix * glm::vec4(position, 1.0f));
+        TransformStore& store = TransformStore::get();
+        uint32_t s = store.slot(handle);
+        simd::multiply(parentGlobalModelMatrix, getLocalModelMatrix(), store.worldMatrices[s]);
+        store.dirty[s] = 0;
     }
 
 
     void setLocalPosition(const glm::vec3& newPosition)
     {
-        position = newPosition;
-        m_isDirty = true;
+        TransformStore& store = TransformStore::get();
+        uint32_t s = store.slot(handle);
+        store.positions[s] = newPosition;
+        store.markDirty(s);
     }
 
     void setScale(const glm::vec3& newScale) {
-        scale = newScale;
-        m_isDirty = true;
+        TransformStore& store = TransformStore::get();
+        uint32_t s = store.slot(handle);
+        store.scales[s] = newScale;
+        store.markDirty(s);
     }
 
     void setEulerRotation(const glm::vec3& newEulerRotation) {
-        eulerRotation = newEulerRotation;
-        m_isDirty = true;
+        TransformStore& store = TransformStore::get();
+        store.setEulerRotation(store.slot(handle), newEulerRotation);
     }
 
     const glm::vec3& getEulerRotation() {
-        return eulerRotation;
+        TransformStore& store = TransformStore::get();
+        return store.eulerRotations[store.slot(handle)];
+    }
+
+    void setRotation(const glm::quat& newRotation) {
+        TransformStore& store = TransformStore::get();
+        store.setRotation(store.slot(handle), newRotation);
+    }
+
+    const glm::quat& getRotation() {
+        TransformStore& store = TransformStore::get();
+        return store.rotations[store.slot(handle)];
     }
 
 
     const glm::vec3& getLocalPosition()
     {
-        return position;
+        TransformStore& store = TransformStore::get();
+        return store.positions[store.slot(handle)];
+    }
+
+    const glm::vec3& getScale() {
+        TransformStore& store = TransformStore::get();
+        return store.scales[store.slot(handle)];
     }
 
     const glm::mat4& getModelMatrix()
     {
-        return modelMatrix;
+        TransformStore& store = TransformStore::get();
+        return store.worldMatrices[store.slot(handle)];
     }
 
-    const void setModelMatrix(glm::mat4& m) {
-        modelMatrix = m;
-        m_isDirty = false;
+    void setModelMatrix(const glm::mat4& m) {
+        TransformStore& store = TransformStore::get();
+        uint32_t s = store.slot(handle);
+        getLocalModelMatrix();
+        store.worldMatrices[s] = m;
+        store.dirty[s] = 0;
     }
 
     bool isDirty()
     {
-        return m_isDirty;
+        TransformStore& store = TransformStore::get();
+        return store.dirty[store.slot(handle)];
     }
 
-    const glm::vec3& getGlobalPosition() const {
-        return globalPosition;
-    }
-
-    void setGlobalPosition(glm::vec3 globalPosition) {
-        this->globalPosition = globalPosition;
+    glm::vec3 getGlobalPosition() const {
+        TransformStore& store = TransformStore::get();
+        return glm::vec3(store.worldMatrices[store.slot(handle)][3]);
     }
 
     void MoveLocalPosition(glm::vec3 offset) {
-        this->setLocalPosition(position + offset);
+        this->setLocalPosition(getLocalPosition() + offset);
     }
 
     void Rotate(glm::vec3 offset) {
-        this->setEulerRotation(eulerRotation + offset);
+        this->setEulerRotation(getEulerRotation() + offset);
+    }
+
+private:
+    TransformStore::Handle handle;
+
+    void copyLocal(const Transform& other) {
+        TransformStore& store = TransformStore::get();
+        uint32_t from = store.slot(other.handle);
+        uint32_t to = store.slot(handle);
+        store.positions[to] = store.positions[from];
+        store.rotations[to] = store.rotations[from];
+        store.eulerRotations[to] = store.eulerRotations[from];
+        store.scales[to] = store.scales[from];
+        store.worldMatrices[to] = store.worldMatrices[from];
+        store.markDirty(to);
     }
 };
 
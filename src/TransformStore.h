@@ -0,0 +1,416 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef TRANSFORMSTORE_H
+#define TRANSFORMSTORE_H
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "Util.h"
+
+class Node;
+
+// Flat storage for every Transform in the scene.
+// Dense arrays are kept in depth-first order, so a parent always comes before its children
+// and the whole subtree of slot i occupies [i, i + subtreeSizes[i]).
+// Handles are stable; slots move whenever the hierarchy is re-sorted.
+// Changes propagate incrementally: marking a slot dirty also flags every ancestor as "subtree contains dirty",
+// and update() jumps over whole subtrees that carry neither flag.
+class TransformStore {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID = UINT32_MAX;
+
+    // per-slot flags Node uses to skip slots that need no extra work
+    enum Flags : uint8_t {
+        INSTANCED = 1 << 0,   // node mirrors its world matrix into an InstanceManager or a PrefabInstancer
+        BOUNDED = 1 << 1,     // node has a model, the scene BVH refits its box when it moves
+    };
+
+    // dense, parent-first
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> eulerRotations;  // degrees, kept in sync with rotations for the inspector and animations
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> localMatrices;   // cached TRS, only rebuilt when the slot itself is dirty
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<int32_t> parents;        // slot of the parent, -1 for roots
+    std::vector<uint32_t> subtreeSizes;
+    std::vector<uint8_t> dirty;          // local TRS changed, use markDirty() so ancestors get flagged too
+    std::vector<uint8_t> subtreeDirty;   // this slot or something below it is dirty
+    std::vector<uint32_t> updateFrames;  // frame in which the world matrix was last recomputed
+    std::vector<uint8_t> flags;
+    std::vector<Handle> handles;         // slot -> handle, INVALID for released slots
+    std::vector<Node*> owners;
+
+    // Slots with any flag whose world matrix changed during the last update().
+    // This is how consumers learn what moved: Node re-syncs INSTANCED slots into their InstanceManager, which queues
+    // the instance in its own dirty list, and the scene BVH refits BOUNDED ones. There are deliberately no per-slot
+    // world version counters to poll, the list already names every change once.
+    std::vector<uint32_t> changedFlagged;
+
+    static TransformStore& get() {
+        static TransformStore store;
+        return store;
+    }
+
+    Handle create() {
+        Handle handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        } else {
+            handle = static_cast<Handle>(slotOf.size());
+            slotOf.push_back(INVALID);
+            parentOf.push_back(INVALID);
+        }
+
+        // new transforms are roots, so appending them keeps the order valid
+        slotOf[handle] = static_cast<uint32_t>(handles.size());
+        parentOf[handle] = INVALID;
+
+        positions.emplace_back(0.0f);
+        rotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+        eulerRotations.emplace_back(0.0f);
+        scales.emplace_back(1.0f);
+        localMatrices.emplace_back(1.0f);
+        worldMatrices.emplace_back(1.0f);
+        parents.push_back(-1);
+        subtreeSizes.push_back(1);
+        dirty.push_back(1);
+        subtreeDirty.push_back(1);
+        updateFrames.push_back(0);
+        flags.push_back(0);
+        handles.push_back(handle);
+        owners.push_back(nullptr);
+        return handle;
+    }
+
+    // grows every array once up front, for spawning many transforms in a row
+    void reserve(size_t count) {
+        const size_t total = handles.size() + count;
+        positions.reserve(total);
+        rotations.reserve(total);
+        eulerRotations.reserve(total);
+        scales.reserve(total);
+        localMatrices.reserve(total);
+        worldMatrices.reserve(total);
+        parents.reserve(total);
+        subtreeSizes.reserve(total);
+        dirty.reserve(total);
+        subtreeDirty.reserve(total);
+        updateFrames.reserve(total);
+        flags.reserve(total);
+        handles.reserve(total);
+        owners.reserve(total);
+        slotOf.reserve(slotOf.size() + count);
+        parentOf.reserve(parentOf.size() + count);
+    }
+
+    void release(Handle handle) {
+        uint32_t s = slotOf[handle];
+        handles[s] = INVALID;
+        owners[s] = nullptr;
+        flags[s] = 0;
+        slotOf[handle] = INVALID;
+        parentOf[handle] = INVALID;
+        freeHandles.push_back(handle);
+        orderDirty = true;
+    }
+
+    uint32_t slot(Handle handle) const {
+        return slotOf[handle];
+    }
+
+    void setParent(Handle handle, Handle parent) {
+        if (parentOf[handle] == parent) return;
+        parentOf[handle] = parent;
+        orderDirty = true;
+        markDirty(slotOf[handle]);
+    }
+
+    Handle getParent(Handle handle) const {
+        return parentOf[handle];
+    }
+
+    void setOwner(Handle handle, Node* owner) {
+        owners[slotOf[handle]] = owner;
+    }
+
+    void setFlag(Handle handle, uint8_t flag, bool value) {
+        uint8_t& f = flags[slotOf[handle]];
+        f = value ? (f | flag) : (f & ~flag);
+    }
+
+    // Flags the slot and walks up until it meets an ancestor that is already flagged, so marking costs O(depth) once.
+    void markDirty(uint32_t s) {
+        dirty[s] = 1;
+        if (orderDirty) {
+            // dense parents are stale, rebuildOrder() recomputes the ancestor bits
+            subtreeDirty[s] = 1;
+            return;
+        }
+        for (int32_t i = static_cast<int32_t>(s); i >= 0 && !subtreeDirty[i]; i = parents[i]) {
+            subtreeDirty[i] = 1;
+        }
+    }
+
+    // true if the world matrix of the slot was recomputed by the last update()
+    bool wasUpdated(uint32_t s) const {
+        return updateFrames[s] == frame;
+    }
+
+    size_t size() const {
+        return handles.size();
+    }
+
+    // translation * rotation * scale (TRS)
+    static glm::mat4 composeLocal(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+        glm::mat4 local;
+        simd::composeTRS(position, rotation, scale, local);
+        return local;
+    }
+
+    void setEulerRotation(uint32_t s, const glm::vec3& eulerDegrees) {
+        eulerRotations[s] = eulerDegrees;
+        rotations[s] = Util::quatFromEulerAngles(eulerDegrees);
+        markDirty(s);
+    }
+
+    void setRotation(uint32_t s, const glm::quat& rotation) {
+        rotations[s] = rotation;
+        eulerRotations[s] = Util::getEulerAnglesFromQuat(rotation);
+        markDirty(s);
+    }
+
+    // Recomputes the world matrix of every dirty slot and of everything below it.
+    // Clean subtrees are skipped in one step, so the cost follows the number of changed slots.
+    void update() {
+        beginUpdate();
+        updateRange(0, handles.size(), changedFlagged);
+    }
+
+    // Same result as update(), but subtrees are split into tasks of roughly grainSize slots.
+    // Nodes whose subtree is bigger than that are computed first on the calling thread, then their
+    // children are scheduled, so a task never reads a world matrix another task is still writing.
+    void update(ThreadPool& pool, uint32_t grainSize = 2048) {
+        beginUpdate();
+        updateRange(0, handles.size(), pool, grainSize);
+    }
+
+    // Like update(), limited to the subtree of root. Dirty slots elsewhere stay dirty for a later update.
+    void update(Handle root, ThreadPool* pool = nullptr, uint32_t grainSize = 2048) {
+        beginUpdate();
+        const uint32_t s = slotOf[root];
+        if (pool) updateRange(s, s + subtreeSizes[s], *pool, grainSize);
+        else updateRange(s, s + subtreeSizes[s], changedFlagged);
+    }
+
+    // Slots [first, second) of the subtree of root, in the current order.
+    std::pair<uint32_t, uint32_t> subtreeRange(Handle root) {
+        if (orderDirty) rebuildOrder();
+        const uint32_t s = slotOf[root];
+        return {s, s + subtreeSizes[s]};
+    }
+
+private:
+    std::vector<uint32_t> slotOf;     // handle -> slot
+    std::vector<Handle> parentOf;     // handle -> parent handle, source of truth for the hierarchy
+    std::vector<Handle> freeHandles;
+    bool orderDirty = false;
+    uint32_t frame = 0;
+
+    struct Task {
+        size_t begin;
+        size_t end;
+        std::vector<uint32_t> changedFlagged;
+    };
+    std::vector<Task> tasks;
+
+    TransformStore() = default;
+
+    void beginUpdate() {
+        if (orderDirty) rebuildOrder();
+        changedFlagged.clear();
+        // 0 is what new slots start with, never use it as a frame number
+        if (++frame == 0) frame = 1;
+    }
+
+    void updateRange(size_t begin, size_t end, ThreadPool& pool, uint32_t grainSize) {
+        if (pool.size() == 1 || end - begin <= grainSize) {
+            updateRange(begin, end, changedFlagged);
+            return;
+        }
+
+        tasks.clear();
+        scheduleSiblings(begin, end, grainSize);
+        for (Task& task : tasks) {
+            pool.submit([this, &task] { updateRange(task.begin, task.end, task.changedFlagged); });
+        }
+        pool.wait();
+
+        for (Task& task : tasks) {
+            changedFlagged.insert(changedFlagged.end(), task.changedFlagged.begin(), task.changedFlagged.end());
+        }
+    }
+
+    bool needsUpdate(size_t i) const {
+        const int32_t p = parents[i];
+        return subtreeDirty[i] || (p >= 0 && updateFrames[p] == frame);
+    }
+
+    void updateRange(size_t begin, size_t end, std::vector<uint32_t>& changedOut) {
+        size_t i = begin;
+        while (i < end) {
+            if (!needsUpdate(i)) {
+                i += subtreeSizes[i];
+                continue;
+            }
+            subtreeDirty[i] = 0;
+
+            const int32_t p = parents[i];
+            const bool parentChanged = p >= 0 && updateFrames[p] == frame;
+            if (dirty[i] || parentChanged) {
+                // a parent moving leaves the cached local matrix untouched
+                if (dirty[i]) {
+                    simd::composeTRS(positions[i], rotations[i], scales[i], localMatrices[i]);
+                    dirty[i] = 0;
+                }
+                if (p < 0) worldMatrices[i] = localMatrices[i];
+                else simd::multiply(worldMatrices[p], localMatrices[i], worldMatrices[i]);
+                updateFrames[i] = frame;
+                if (flags[i]) changedOut.push_back(static_cast<uint32_t>(i));
+            }
+            i++;
+        }
+    }
+
+    // [begin, end) is a run of sibling subtrees whose parent is already up to date.
+    // Small neighbouring subtrees are batched into one task, big ones are opened up recursively.
+    // Only subtrees with pending changes count towards the batch size.
+    void scheduleSiblings(size_t begin, size_t end, uint32_t grainSize) {
+        size_t batchBegin = begin;
+        size_t work = 0;
+        size_t i = begin;
+        while (i < end) {
+            const uint32_t size = subtreeSizes[i];
+            if (!needsUpdate(i)) {
+                // stays inside the batch, updateRange() skips it in one step
+                i += size;
+                continue;
+            }
+            if (size > grainSize) {
+                addTask(batchBegin, i);
+                updateRange(i, i + 1, changedFlagged);
+                scheduleSiblings(i + 1, i + size, grainSize);
+                i += size;
+                batchBegin = i;
+                work = 0;
+                continue;
+            }
+
+            i += size;
+            work += size;
+            if (work >= grainSize) {
+                addTask(batchBegin, i);
+                batchBegin = i;
+                work = 0;
+            }
+        }
+        if (work > 0) addTask(batchBegin, end);
+    }
+
+    void addTask(size_t begin, size_t end) {
+        if (begin >= end) return;
+        tasks.push_back({begin, end, {}});
+    }
+
+    template<typename T>
+    static void permute(std::vector<T>& data, const std::vector<uint32_t>& order) {
+        std::vector<T> sorted;
+        sorted.reserve(order.size());
+        for (uint32_t oldSlot : order) {
+            sorted.push_back(data[oldSlot]);
+        }
+        data.swap(sorted);
+    }
+
+    // Re-sorts the dense arrays depth-first and drops released slots.
+    void rebuildOrder() {
+        const size_t handleCount = slotOf.size();
+
+        // children of every handle in CSR form, roots are collected separately
+        std::vector<uint32_t> childStart(handleCount + 1, 0);
+        std::vector<Handle> roots;
+        for (Handle h = 0; h < handleCount; h++) {
+            if (slotOf[h] == INVALID) continue;
+            Handle p = parentOf[h];
+            if (p == INVALID || slotOf[p] == INVALID) roots.push_back(h);
+            else childStart[p + 1]++;
+        }
+        for (size_t h = 0; h < handleCount; h++) {
+            childStart[h + 1] += childStart[h];
+        }
+        std::vector<Handle> childList(childStart[handleCount]);
+        std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+        for (Handle h = 0; h < handleCount; h++) {
+            if (slotOf[h] == INVALID) continue;
+            Handle p = parentOf[h];
+            if (p != INVALID && slotOf[p] != INVALID) childList[fill[p]++] = h;
+        }
+
+        // iterative pre-order walk, order holds old slots
+        std::vector<uint32_t> order;
+        std::vector<int32_t> newParents;
+        order.reserve(handleCount);
+        newParents.reserve(handleCount);
+        std::vector<std::pair<Handle, int32_t>> stack;
+        for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+            stack.emplace_back(*it, -1);
+        }
+        while (!stack.empty()) {
+            auto [h, parentSlot] = stack.back();
+            stack.pop_back();
+            const int32_t newSlot = static_cast<int32_t>(order.size());
+            order.push_back(slotOf[h]);
+            newParents.push_back(parentSlot);
+            for (uint32_t c = childStart[h + 1]; c > childStart[h]; c--) {
+                stack.emplace_back(childList[c - 1], newSlot);
+            }
+        }
+
+        permute(positions, order);
+        permute(rotations, order);
+        permute(eulerRotations, order);
+        permute(scales, order);
+        permute(localMatrices, order);
+        permute(worldMatrices, order);
+        permute(dirty, order);
+        permute(updateFrames, order);
+        permute(flags, order);
+        permute(handles, order);
+        permute(owners, order);
+        parents.swap(newParents);
+
+        subtreeSizes.assign(order.size(), 1);
+        subtreeDirty = dirty;
+        for (size_t i = order.size(); i-- > 0;) {
+            slotOf[handles[i]] = static_cast<uint32_t>(i);
+            if (parents[i] >= 0) {
+                subtreeSizes[parents[i]] += subtreeSizes[i];
+                subtreeDirty[parents[i]] |= subtreeDirty[i];
+            }
+        }
+
+        orderDirty = false;
+    }
+};
+
+#endif //TRANSFORMSTORE_H
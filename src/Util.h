@@ -5,10 +5,22 @@
 #ifndef UTIL_H
 #define UTIL_H
 #include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 static class Util {
 public:
 
+    // one generator for the whole app, seeded once instead of per call
+    static std::mt19937& rng() {
+        static std::mt19937 generator(std::random_device{}());
+        return generator;
+    }
+
     static double round_up(double value, int decimal_places) {
         const double multiplier = std::pow(10.0, decimal_places);
         return std::ceil(value * multiplier) / multiplier;
@@ -31,23 +43,33 @@ public:
     }
 
 
+    // Quaternion for the Y * X * Z euler rotation used by Transform, angles in degrees.
+    static glm::quat quatFromEulerAngles(const glm::vec3& eulerDegrees) {
+        const glm::vec3 r = glm::radians(eulerDegrees);
+        return glm::angleAxis(r.y, glm::vec3(0.0f, 1.0f, 0.0f)) *
+               glm::angleAxis(r.x, glm::vec3(1.0f, 0.0f, 0.0f)) *
+               glm::angleAxis(r.z, glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    // Inverse of quatFromEulerAngles, returns degrees.
+    static glm::vec3 getEulerAnglesFromQuat(const glm::quat& q) {
+        const glm::mat3 m = glm::mat3_cast(q);
+        const float x = std::asin(-glm::clamp(m[2][1], -1.0f, 1.0f));
+        float y, z;
+        if (std::abs(m[2][1]) < 0.9999999f) {
+            y = std::atan2(m[2][0], m[2][2]);
+            z = std::atan2(m[0][1], m[1][1]);
+        } else {
+            y = std::atan2(-m[0][2], m[0][0]);
+            z = 0.0f;
+        }
+        return glm::degrees(glm::vec3(x, y, z));
+    }
+
+
     static glm::vec3 getDirectionFromEulerAngles(float pitch, float yaw, float roll = 0.0f) {
-        pitch = glm::radians(pitch);
-        yaw = glm::radians(yaw);
-        roll = glm::radians(roll);
-        glm::mat4 rotationYaw = glm::rotate(glm::mat4(1.0f), yaw, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 rotationPitch = glm::rotate(glm::mat4(1.0f), pitch, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 rotationRoll = glm::rotate(glm::mat4(1.0f), roll, glm::vec3(0.0f, 0.0f, 1.0f));
-        glm::vec4 forward(0.0f, 0.0f, -1.0f, 1.0f);
-
-        // Combine the rotations: yaw * pitch * roll (order matters)
-        glm::mat4 rotationMatrix = rotationYaw * rotationPitch * rotationRoll;
-
-        // Apply the combined rotation to the default forward vector
-        glm::vec4 rotated = rotationMatrix * forward;
-
-        // Return the normalized direction vector
-        return glm::normalize(-glm::vec3(rotated));
+        // (yaw * pitch * roll) applied to the negated forward vector (0, 0, -1)
+        return glm::normalize(quatFromEulerAngles({pitch, yaw, roll}) * glm::vec3(0.0f, 0.0f, 1.0f));
     }
 
     static float lerp(float a, float b, float t) {
@@ -0,0 +1,189 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#define MAX_BONE_INFLUENCE 4
+
+// Full precision vertex as loaded, kept on the CPU for bounds, simplification, occlusion and batching.
+// The GPU gets it in one of the VertexFormat layouts.
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal = glm::vec3(0.0f);
+    glm::vec2 texCoords;
+    //tangent
+    glm::vec3 tangent = glm::vec3(0.0f);
+    // bitangent
+    glm::vec3 biTangent = glm::vec3(0.0f);
+    //bone indexes which will influence this vertex
+    int m_BoneIDs[MAX_BONE_INFLUENCE] = {-1, -1, -1, -1};
+    //weights from each bone
+    float m_Weights[MAX_BONE_INFLUENCE] = {};
+};
+
+// GPU layouts of Vertex. Every layout has 0 position, 1 normal and 2 texture coordinates, the rest differs:
+// FULL: 3 vec3 tangent, 4 vec3 bitangent, 5 bone ids, 6 bone weights. 88 bytes.
+// COMPACT: float position, normal in 10:10:10:2 snorm, half float UVs. 3 is a vec4 holding the tangent frame
+// as a snorm16 quaternion whose sign is the bitangent's handedness, 4 is switched off, so a shader reading
+// the tangent at 3 has to rebuild tangent and bitangent from the quaternion. No bone data. 28 bytes.
+// SKINNED: COMPACT with four 8 bit bone ids and 8 bit unorm weights at 5 and 6. 36 bytes.
+class VertexFormat {
+public:
+    enum Format {
+        FULL,
+        COMPACT,
+        SKINNED,
+    };
+
+    struct CompactVertex {
+        glm::vec3 position;
+        uint32_t normal;
+        uint32_t texCoords;
+        int16_t tangentFrame[4];
+    };
+
+    struct SkinnedVertex {
+        CompactVertex base;
+        uint8_t boneIds[MAX_BONE_INFLUENCE];
+        uint8_t weights[MAX_BONE_INFLUENCE];
+    };
+
+    static size_t stride(Format format) {
+        switch (format) {
+            case COMPACT: return sizeof(CompactVertex);
+            case SKINNED: return sizeof(SkinnedVertex);
+            default: return sizeof(Vertex);
+        }
+    }
+
+    // The smallest layout that keeps what the vertices carry, bone data only when some vertex has a weight.
+    static Format choose(const std::vector<Vertex>& vertices) {
+        for (const Vertex& vertex : vertices) {
+            for (float weight : vertex.m_Weights) {
+                if (weight > 0.0f) return SKINNED;
+            }
+        }
+        return COMPACT;
+    }
+
+    // Converts the vertices to the format, out is resized to fit.
+    static void pack(Format format, const std::vector<Vertex>& vertices, std::vector<unsigned char>& out) {
+        out.resize(vertices.size() * stride(format));
+        if (format == FULL) {
+            if (!vertices.empty()) std::memcpy(out.data(), vertices.data(), out.size());
+            return;
+        }
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const Vertex& vertex = vertices[i];
+            CompactVertex* packed = reinterpret_cast<CompactVertex*>(out.data() + i * stride(format));
+            packed->position = vertex.position;
+            packed->normal = glm::packSnorm3x10_1x2(glm::vec4(safeNormalize(vertex.normal, glm::vec3(0, 1, 0)), 0.0f));
+            packed->texCoords = glm::packHalf2x16(vertex.texCoords);
+            packTangentFrame(vertex, packed->tangentFrame);
+            if (format == SKINNED) packBones(vertex, *reinterpret_cast<SkinnedVertex*>(packed));
+        }
+    }
+
+    // Points attributes 0 to 6 of the bound vertex array at the format's layout in the bound array buffer.
+    // Attributes a format leaves out are switched off, the shaders read their default value.
+    static void describe(Format format) {
+        const GLsizei size = static_cast<GLsizei>(stride(format));
+        for (unsigned int attribute = 0; attribute <= 6; attribute++) glEnableVertexAttribArray(attribute);
+        if (format == FULL) {
+            // vertex Positions
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, size, (void*)0);
+            // vertex normals
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, normal));
+            // vertex texture coords
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, texCoords));
+            // vertex tangent
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, tangent));
+            // vertex bitangent
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, biTangent));
+            // ids
+            glVertexAttribIPointer(5, 4, GL_INT, size, (void*)offsetof(Vertex, m_BoneIDs));
+            // weights
+            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, m_Weights));
+            return;
+        }
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, size, (void*)offsetof(CompactVertex, position));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, size, (void*)offsetof(CompactVertex, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, size, (void*)offsetof(CompactVertex, texCoords));
+        glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, size, (void*)offsetof(CompactVertex, tangentFrame));
+        glDisableVertexAttribArray(4);
+        if (format == SKINNED) {
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, size, (void*)offsetof(SkinnedVertex, boneIds));
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, size, (void*)offsetof(SkinnedVertex, weights));
+        } else {
+            glDisableVertexAttribArray(5);
+            glDisableVertexAttribArray(6);
+        }
+    }
+
+private:
+    static glm::vec3 safeNormalize(const glm::vec3& v, const glm::vec3& fallback) {
+        const float length = glm::length(v);
+        return length > 1e-8f ? v / length : fallback;
+    }
+
+    // Rotation from tangent space to object space, with w kept away from 0 so the sign survives quantization.
+    // A negative quaternion means the bitangent is cross(tangent, normal) instead of cross(normal, tangent).
+    static void packTangentFrame(const Vertex& vertex, int16_t* out) {
+        const glm::vec3 n = safeNormalize(vertex.normal, glm::vec3(0, 1, 0));
+        glm::vec3 t = vertex.tangent - n * glm::dot(n, vertex.tangent);
+        if (glm::dot(t, t) < 1e-12f) {
+            // no tangent, any direction perpendicular to the normal
+            t = std::abs(n.x) < 0.9f ? glm::cross(n, glm::vec3(1, 0, 0)) : glm::cross(n, glm::vec3(0, 1, 0));
+        }
+        t = glm::normalize(t);
+        const glm::vec3 b = glm::cross(n, t);
+
+        glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+        if (q.w < 0.0f) q = -q;
+        constexpr float bias = 1.0f / 32767.0f;
+        if (q.w < bias) {
+            const float scale = std::sqrt(1.0f - bias * bias);
+            q = glm::quat(bias, q.x * scale, q.y * scale, q.z * scale);
+        }
+        if (glm::dot(b, vertex.biTangent) < 0.0f) q = -q;
+
+        const float components[4] = {q.x, q.y, q.z, q.w};
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<int16_t>(std::lround(std::clamp(components[i], -1.0f, 1.0f) * 32767.0f));
+        }
+    }
+
+    // Weights are renormalized to sum to 255 after rounding, ids past 255 or unused ones get no weight.
+    static void packBones(const Vertex& vertex, SkinnedVertex& out) {
+        float total = 0.0f;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+            const bool used = vertex.m_BoneIDs[i] >= 0 && vertex.m_BoneIDs[i] <= 255 && vertex.m_Weights[i] > 0.0f;
+            total += used ? vertex.m_Weights[i] : 0.0f;
+        }
+        int remaining = 255;
+        int heaviest = 0;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+            const bool used = total > 0.0f && vertex.m_BoneIDs[i] >= 0 && vertex.m_BoneIDs[i] <= 255 && vertex.m_Weights[i] > 0.0f;
+            out.boneIds[i] = used ? static_cast<uint8_t>(vertex.m_BoneIDs[i]) : 0;
+            out.weights[i] = used ? static_cast<uint8_t>(std::lround(vertex.m_Weights[i] / total * 255.0f)) : 0;
+            remaining -= out.weights[i];
+            if (out.weights[i] > out.weights[heaviest]) heaviest = i;
+        }
+        if (total > 0.0f) out.weights[heaviest] = static_cast<uint8_t>(out.weights[heaviest] + remaining);
+    }
+};
+
+#endif //VERTEXFORMAT_H
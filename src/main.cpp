@@ -21,16 +21,32 @@
 #include "Model.h"
 #include "Shader.h"
 
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <thread>
 
 #include "Animator.h"
+#include "DeferredRenderer.h"
+#include "FrameUniforms.h"
+#include "GeometryPool.h"
+#include "GLStateCache.h"
+#include "GpuTimer.h"
 #include "Input.h"
+#include "LightClusters.h"
+#include "LightManager.h"
+#include "Lod.h"
 #include "Node.h"
+#include "OcclusionCuller.h"
 #include "Plane.h"
+#include "PrefabInstancer.h"
+#include "RenderQueue.h"
 #include "Robot.h"
+#include "SceneBVH.h"
+#include "StaticBatcher.h"
 #include "Skybox.h"
+#include "StreamingBuffer.h"
+#include "ThreadPool.h"
 #include "Torus.h"
 #include "Util.h"
 #include "MeshInstance/MeshInstance.h"
@@ -46,9 +62,11 @@ void init_imgui();
 void handle_input(GLFWwindow *window);
 void update();
 void render();
-void renderEntityAndChildren(Node* entity);
+void renderEntities();
+void renderInstances();
+void renderPrefabEnvironment();
+InstanceManager* createStoneField();
 void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightModel);
-void renderLights();
 void setupShaders();
 
 void imgui_begin();
@@ -93,11 +111,13 @@ bool wireframe = false;
 glm::vec3 rootRotation = glm::vec3(0.0f);
 
 std::vector<InstanceManager*> instances;
+std::vector<PrefabInstancer*> prefabs;
+// test field for the compact instance formats, built the first time the inspector turns it on
+bool stoneFieldEnabled = false;
+InstanceManager* stoneField = nullptr;
 
 Input Input;
 
-std::vector<Node*> pointLights;
-std::vector<Node*> spotLights;
 
 std::vector<glm::vec3> lightColors = {
     {0.4f, 0.4f, 0.4f},
@@ -114,6 +134,21 @@ Shader* skyboxShader;
 Shader* reflectiveShader;
 Shader* refractiveShader;
 Shader* testShader;
+// geometry pass of the deferred path, for meshes and instances
+Shader* gbufferShader;
+Shader* gbufferInstancedShader;
+// instanced variants the render queues switch to for repeated meshes
+Shader* emissionInstancedShader;
+Shader* reflectiveInstancedShader;
+Shader* refractiveInstancedShader;
+// prefab instances, the tint comes in per instance
+Shader* prefabShader;
+Shader* prefabGbufferShader;
+Shader* prefabReflectiveShader;
+Shader* prefabRefractiveShader;
+// instance manager programs per instance format, MATRIX is advancedShader and gbufferInstancedShader
+Shader* instanceShaders[InstanceManager::FORMAT_COUNT];
+Shader* gbufferInstanceShaders[InstanceManager::FORMAT_COUNT];
 glm::vec3 ior = {1.52f, 1.50f, 1.48f};
 float chromaticAbberationStrength = 0.02;
 
@@ -130,8 +165,31 @@ Robot* robot;
 Node* headNode;
 Node* torsoNode;
 
+ThreadPool* threadPool;
+
+SceneBVH sceneBVH;
+std::vector<Entity> visibleEntities;
+float aspectRatio = static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT);
+// in pixels of the default framebuffer, which gl_FragCoord counts in
+glm::vec2 framebufferSize = glm::vec2(WINDOW_WIDTH, WINDOW_HEIGHT);
+
+LodSettings lodSettings;
+OcclusionCuller occlusionCuller;
+RenderQueue renderQueue;
+// what the G-buffer can't hold, drawn after the lighting pass in deferred mode
+RenderQueue forwardQueue;
+FrameUniforms frameUniforms;
+LightClusters lightClusters;
+StaticBatcher staticBatcher;
+DeferredRenderer deferredRenderer;
+bool deferredShading = false;
+GpuTimer geometryTimer;
+GpuTimer lightingTimer;
+GpuTimer forwardTimer;
+// triangles drawn by renderEntities() last frame, and what they would have been at full detail
+size_t renderedTriangles = 0;
+size_t fullTriangles = 0;
 
-GLuint framebuffer, colorTexture, depthTexture;
 int main(int, char**)
 {
     if (!init())
@@ -146,6 +204,8 @@ int main(int, char**)
 
     stbi_set_flip_vertically_on_load(true);
 
+    threadPool = new ThreadPool();
+    spdlog::info("Started thread pool with {} threads.", threadPool->size());
 
     regularShader = new Shader("res/shaders/basic.vert", "res/shaders/blinnphong/shader.frag");
     advancedShader = new Shader("res/shaders/blinnphong/shader.vert", "res/shaders/blinnphong/shader.frag");
@@ -154,6 +214,33 @@ int main(int, char**)
     reflectiveShader = new Shader("res/shaders/reflective/shader.vert", "res/shaders/reflective/shader.frag");
     refractiveShader = new Shader("res/shaders/refractive/shader.vert", "res/shaders/refractive/shader.frag");
     testShader = new Shader("res/shaders/test.vert", "res/shaders/test.frag");
+    gbufferShader = new Shader("res/shaders/basic.vert", "res/shaders/deferred/gbuffer.frag");
+    gbufferInstancedShader = new Shader("res/shaders/blinnphong/shader.vert", "res/shaders/deferred/gbuffer.frag");
+    emissionInstancedShader = new Shader("res/shaders/emission/instanced.vert", "res/shaders/emission/instanced.frag");
+    reflectiveInstancedShader = new Shader("res/shaders/reflective/instanced.vert", "res/shaders/reflective/shader.frag");
+    refractiveInstancedShader = new Shader("res/shaders/refractive/instanced.vert", "res/shaders/refractive/shader.frag");
+    prefabShader = new Shader("res/shaders/prefab/shader.vert", "res/shaders/blinnphong/shader.frag", nullptr, "TINT");
+    prefabGbufferShader = new Shader("res/shaders/prefab/shader.vert", "res/shaders/deferred/gbuffer.frag", nullptr, "TINT");
+    prefabReflectiveShader = new Shader("res/shaders/prefab/environment.vert", "res/shaders/reflective/shader.frag", nullptr, "TINT");
+    prefabRefractiveShader = new Shader("res/shaders/prefab/environment.vert", "res/shaders/refractive/shader.frag", nullptr, "TINT");
+    instanceShaders[InstanceManager::MATRIX] = advancedShader;
+    gbufferInstanceShaders[InstanceManager::MATRIX] = gbufferInstancedShader;
+    for (InstanceManager::Format format : {InstanceManager::AFFINE, InstanceManager::QUATERNION}) {
+        const char* define = InstanceManager::formatDefine(format);
+        instanceShaders[format] = new Shader("res/shaders/blinnphong/shader.vert", "res/shaders/blinnphong/shader.frag", nullptr, define);
+        gbufferInstanceShaders[format] = new Shader("res/shaders/blinnphong/shader.vert", "res/shaders/deferred/gbuffer.frag", nullptr, define);
+    }
+    for (RenderQueue* queue : {&renderQueue, &forwardQueue}) {
+        queue->setInstancedVariant(regularShader, advancedShader);
+        queue->setInstancedVariant(gbufferShader, gbufferInstancedShader);
+        queue->setInstancedVariant(emissionShader, emissionInstancedShader);
+        queue->setInstancedVariant(reflectiveShader, reflectiveInstancedShader);
+        queue->setInstancedVariant(refractiveShader, refractiveInstancedShader);
+    }
+    deferredRenderer.create("res/shaders/deferred/lighting.vert", "res/shaders/deferred/lighting.frag");
+    frameUniforms.create();
+    LightManager::get().create();
+    lightClusters.create();
 
     camera.setPitch(-20.0f);
 
@@ -174,8 +261,10 @@ int main(int, char**)
     Model houseBody("res/models/house/body/housebody.obj");
     Model houseRoof("res/models/house/roof/roof.obj");
 
-    auto* houseInstances = new InstanceManager(houseBody);
-    auto* houseRoofInstances = new InstanceManager(houseRoof);
+    // one record per house drives both the body and the roof on top of it
+    auto* housePrefabs = new PrefabInstancer();
+    housePrefabs->addPart(&houseBody);
+    housePrefabs->addPart(&houseRoof, glm::translate(glm::mat4(1.0f), glm::vec3(0, 2, 0)));
 
 
     root = new Node();
@@ -201,6 +290,7 @@ int main(int, char**)
     Node* groundNode = new Node(&ground);
     groundNode->setLabel("Ground");
     groundNode->setStationary(true);
+    groundNode->setOccluder(true);
     groundNode->transform.setScale({200, 1, 200 });
 
     root->addChild(groundNode);
@@ -246,6 +336,13 @@ int main(int, char**)
 
     Node* housesNodeP = root->getLastChild();
 
+    // one house is a scaled node carrying a prefab record, every row gets a batch of copies.
+    // The template registers itself like any node, it is destroyed once the rows are spawned.
+    auto housePrefab = std::make_unique<Node>();
+    housePrefab->setStationary(true);
+    housePrefab->setOccluder(true);
+    housePrefab->transform.setScale({2, 2, 2});
+
     for ( int x = width/2 * -1; x < width/2; x++)
     {
         std::unique_ptr<Node> row = std::make_unique<Node>();
@@ -254,72 +351,31 @@ int main(int, char**)
 
         housesNodeP->addChild(std::move(row));
         Node* lastRowNode = housesNodeP->getLastChild();
-        for ( int y = height/2 * -1; y < height/2; y++) {
 
+        std::vector<Node::SpawnTransform> transforms;
+        for ( int y = height/2 * -1; y < height/2; y++) {
+            Node::SpawnTransform t;
+            t.position.x += separation * x;
+            t.position.z += separation * y;
+            t.scale = {2, 2, 2};
+            transforms.push_back(t);
+        }
 
-            // Node* n = new Node();
-            std::unique_ptr<Node> n = std::make_unique<Node>();
-            n->setStationary(true);
+        for (Node* n : lastRowNode->spawnBatch(transforms.size(), *housePrefab, transforms)) {
             n->setLabel("House " + std::to_string(id));
-            glm::vec3 pos = n->transform.getLocalPosition();
-            pos.x += separation * x;
-            pos.z += separation * y;
-            n->transform.setScale({2, 2, 2});
-            n->transform.setLocalPosition(pos);
-            n->transform.computeModelMatrix();
-
-            std::unique_ptr<Node> body = std::make_unique<Node>();
-            // Node* body = new Node();
-            body->setStationary(true);
-            body->setLabel("Body");
-            body->transform.computeModelMatrix(n->transform.getModelMatrix());
-
-            std::unique_ptr<Node> roof = std::make_unique<Node>();
-            // Node* roof = new Node();
-            roof->setStationary(true);
-            roof->setLabel("Roof");
-
-            glm::vec3 roofPos = roof->transform.getLocalPosition();
-            roofPos.y += 2;
-            roof->transform.setLocalPosition(roofPos);
-            roof->transform.computeModelMatrix(n->transform.getModelMatrix());
-
-            auto* hBodyI = new Instance(houseBody, id);
-            auto* hRoofI = new Instance(houseRoof, id);
             id++;
 
-            hBodyI->modelMatrix = body->transform.getModelMatrix();
-            hRoofI->modelMatrix = roof->transform.getModelMatrix();
-
-            body->instance = hBodyI;
-            roof->instance = hRoofI;
-
-            // root->addChild(n);
-            lastRowNode->addChild(std::move(n));
-            hBodyI->parentManager = houseInstances;
-            hRoofI->parentManager = houseRoofInstances;
-
-            houseInstances->addMatrix(hBodyI->modelMatrix);
-            houseRoofInstances->addMatrix(hRoofI->modelMatrix);
-            Node* lastEntity = lastRowNode->getLastChild();
-
-            // lastEntity->addChild(body);
-            // lastEntity->addChild(roof);
-            lastEntity->addChild(std::move(body));
-            lastEntity->addChild(std::move(roof));
-
+            // the real transform is synced by the first updateSelfAndChild()
+            n->setPrefabInstance(housePrefabs, housePrefabs->add());
         }
 
         rowNum++;
     }
+    housePrefab.reset();
 
     // -----------------------------
 
-    instances.push_back(houseInstances);
-    instances.push_back(houseRoofInstances);
-
-    houseInstances->instantiate();
-    houseRoofInstances->instantiate();
+    prefabs.push_back(housePrefabs);
 
     root->updateSelfAndChild(deltaTime);
 
@@ -343,8 +399,10 @@ int main(int, char**)
 
     skybox = new Skybox(skyboxShader, skyboxFaces);
 
-    reflectiveShader->use();
-    reflectiveShader->setInt("skybox", 0);
+    for (Shader* shader : {reflectiveShader, reflectiveInstancedShader, prefabReflectiveShader}) {
+        shader->use();
+        shader->setInt("skybox", 0);
+    }
 
     std::vector<std::string> robotBones = {
         "Head",
@@ -445,35 +503,13 @@ int main(int, char**)
     }
 
     //3D
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_CULL_FACE);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-    // Create color attachment
-    glGenTextures(1, &colorTexture);
-    glBindTexture(GL_TEXTURE_2D, colorTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, WINDOW_WIDTH, WINDOW_WIDTH, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
-
-    // Create depth attachment
-    glGenTextures(1, &depthTexture);
-    glBindTexture(GL_TEXTURE_2D, depthTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, WINDOW_WIDTH, WINDOW_WIDTH, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
-
-    // Check framebuffer
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Framebuffer is not complete!" << std::endl;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateCache& state = GLStateCache::get();
+    state.setEnabled(GL_DEPTH_TEST, true);
+    state.setEnabled(GL_BLEND, true);
+    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.setEnabled(GL_CULL_FACE, true);
+    state.polygonMode(GL_FILL);
+
 
     MeshInstance* meshInstance = new MeshInstance();
     meshInstance->LoadModel("res/models/cube/cube.obj");
@@ -498,8 +534,6 @@ int main(int, char**)
 
         // OpenGL rendering code here
         render();
-        houseInstances->Draw(advancedShader);
-        houseRoofInstances->Draw(advancedShader);
 
         // regularShader->use();
         // glm::mat4 modelMatrix = glm::mat4(1.0f);
@@ -530,6 +564,7 @@ int main(int, char**)
     delete advancedShader;
     delete regularShader;
     delete emissionShader;
+    delete threadPool;
 
     return 0;
 }
@@ -665,15 +700,15 @@ void handle_input(GLFWwindow *window)
 
         if (Input.isKeyPressed(GLFW_KEY_W)) {
             float distance = robot->speed * deltaTime;
-            float dx = (float) (distance * std::sin(glm::radians(torsoNode->transform.eulerRotation.y)));
-            float dz = (float) (distance * std::cos(glm::radians(torsoNode->transform.eulerRotation.y)));
+            float dx = (float) (distance * std::sin(glm::radians(torsoNode->transform.getEulerRotation().y)));
+            float dz = (float) (distance * std::cos(glm::radians(torsoNode->transform.getEulerRotation().y)));
             torsoNode->transform.MoveLocalPosition({dx, 0, dz});
         }
 
         if (Input.isKeyPressed(GLFW_KEY_S)) {
             float distance = -robot->speed * deltaTime;
-            float dx = (float) (distance * std::sin(glm::radians(torsoNode->transform.eulerRotation.y)));
-            float dz = (float) (distance * std::cos(glm::radians(torsoNode->transform.eulerRotation.y)));
+            float dx = (float) (distance * std::sin(glm::radians(torsoNode->transform.getEulerRotation().y)));
+            float dz = (float) (distance * std::cos(glm::radians(torsoNode->transform.getEulerRotation().y)));
             torsoNode->transform.MoveLocalPosition({dx, 0, dz});
         }
 
@@ -689,14 +724,14 @@ void handle_input(GLFWwindow *window)
 
         if (Input.isKeyPressed(GLFW_KEY_Z)) {
             float rotation = robot->rotationSpeed * deltaTime;
-            if (headNode->transform.eulerRotation.y <= 45.0f) {
+            if (headNode->transform.getEulerRotation().y <= 45.0f) {
                 headNode->transform.Rotate({0, rotation, 0});
             }
         }
 
         if (Input.isKeyPressed(GLFW_KEY_C)) {
             float rotation = -robot->rotationSpeed * deltaTime;
-            if (headNode->transform.eulerRotation.y >= -45.0f) {
+            if (headNode->transform.getEulerRotation().y >= -45.0f) {
                 headNode->transform.Rotate({0, rotation, 0});
             }
         }
@@ -723,118 +758,117 @@ void handle_input(GLFWwindow *window)
 
 void updateLights() {
     // Node* flashlightNode = root->find("Spot Light Flashlight");
-    flashlightNode->light->setDirection(camera.Front);
-    flashlightNode->light->setForTypeVec3("position", camera.Position);
+    flashlightNode->getLight()->setDirection(camera.Front);
+    flashlightNode->getLight()->setPosition(camera.Position);
 }
 
 void update()
 {
 
-    root->updateSelfAndChild(deltaTime);
+    root->updateSelfAndChild(deltaTime, threadPool);
+    sceneBVH.update();
+    staticBatcher.update();
+    // pixel errors are measured in framebuffer pixels, which HiDPI displays have more of than window units
+    lodSettings.setProjection(camera.GetFov(), framebufferSize.y);
     updateLights();
 
     animator->Update(deltaTime);
 
     if (controllingRobot) {
-        camera.setPosition(Util::lerp(camera.Position, cameraHandleForRobot->transform.globalPosition, 5 * deltaTime));
-        camera.LookAt(torsoNode->transform.globalPosition);
+        camera.setPosition(Util::lerp(camera.Position, cameraHandleForRobot->transform.getGlobalPosition(), 5 * deltaTime));
+        camera.LookAt(torsoNode->transform.getGlobalPosition());
     }
 }
 
 void render()
 {
+    GLStateCache::get().resetStats();
+    Shader::resetStats();
     // glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     // OpenGL Rendering code goes here
     // glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glm::mat4 view = camera.GetViewMatrix(); 
-    advancedShader->use();
-    advancedShader->setMat4("view", view);
-    advancedShader->setVec3("viewPos", camera.Position);
-
-    emissionShader->use();
-    emissionShader->setMat4("view", view);
-
-    regularShader->use();
-    regularShader->setMat4("view", view);
-
-    reflectiveShader->use();
-    reflectiveShader->setMat4("view", view);
-
-    refractiveShader->use();
-    refractiveShader->setMat4("view", view);
-
-    testShader->use();
-    testShader->setMat4("view", view);
-
-    renderEntityAndChildren(root);
-
-    view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
+    // camera and time for every program in one upload
+    frameUniforms.update(camera, aspectRatio, lastFrame, deltaTime);
+    // lights changed since the last frame, also one upload
+    LightManager::get().upload();
+    lightClusters.build(camera.GetViewMatrix(), camera.GetProjectionMatrix(aspectRatio), camera.NearPlane, camera.FarPlane,
+                        framebufferSize.x, framebufferSize.y, threadPool);
+    lightClusters.bind();
+
+    // Deferred: meshes and instances fill the G-buffer, one full screen pass lights it and the rest is drawn forward.
+    // Forward: everything is lit while it's drawn, the forward queue stays empty.
+    geometryTimer.begin();
+    if (deferredShading) deferredRenderer.beginGeometry();
+    renderEntities();
+    renderInstances();
+    if (deferredShading) deferredRenderer.endGeometry();
+    geometryTimer.end();
+
+    if (deferredShading) {
+        lightingTimer.begin();
+        deferredRenderer.light();
+        lightingTimer.end();
+    }
 
-    skybox->Draw(view);
+    forwardTimer.begin();
+    GLStateCache::get().polygonMode(wireframe ? GL_LINE : GL_FILL);
+    forwardQueue.execute(skybox->getCubemapTexture());
+    if (deferredShading) renderPrefabEnvironment();
+    skybox->Draw();
+    forwardTimer.end();
+    // everything the streaming buffers handed out this frame is in use until this fence
+    StreamingBuffer::nextFrame();
     // glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+// Culls the instance managers and the prefabs against the frustum and the occlusion buffer renderEntities() built,
+// then draws them. Reflective and refractive prefab records wait for the forward pass in deferred mode.
+void renderInstances() {
+    Frustum frustum = camera.GetFrustum(aspectRatio);
+    for (InstanceManager* manager : instances) {
+        manager->cull(frustum, threadPool);
+        occlusionCuller.cull(*manager, threadPool);
+        manager->selectLods(camera.Position, lodSettings);
+        Shader** shaders = deferredShading ? gbufferInstanceShaders : instanceShaders;
+        manager->Draw(shaders[manager->getFormat()]);
+    }
+    for (PrefabInstancer* prefab : prefabs) {
+        prefab->update(frustum, [](const AABB& box) { return occlusionCuller.isVisible(box); }, camera.Position, lodSettings);
+        prefab->draw(STANDARD, deferredShading ? prefabGbufferShader : prefabShader, skybox->getCubemapTexture());
+    }
+    if (!deferredShading) renderPrefabEnvironment();
+}
 
-
-void renderLights() {
-    // advancedShader->use();
-    // regularShader.use();
-
-    Shader* shader = regularShader;
-    for (int s = 0; s < 2; s++) {
-        if (s == 0) shader = advancedShader;
-        else shader = regularShader;
-
-        shader->use();
-        //Directional light
-        Node* dirLightNode = root->find("Dir Light");
-        Light* dirLight = dirLightNode->light;
-        shader->setBool("dirLight.isOn", dirLight->active);
-        shader->setVec3("dirLight.direction", dirLight->getDirection());
-        shader->setVec3("dirLight.ambient", dirLight->getAmbient());
-        shader->setVec3("dirLight.diffuse", dirLight->getDiffuse());
-        shader->setVec3("dirLight.specular", dirLight->getSpecular());
-
-        for (auto lightNode : pointLights) {
-            Light* light = lightNode->light;
-
-            std::string base = "pointLights[" + std::to_string(light->id) + "]";
-            shader->setBool(base + ".isOn", light->active);
-            shader->setVec3(base + ".position", lightNode->transform.getGlobalPosition());
-            shader->setVec3(base + ".ambient", light->getAmbient());
-            shader->setVec3(base + ".diffuse", light->getDiffuse());
-            shader->setVec3(base + ".specular", light->getSpecular());
-            shader->setFloat(base + ".constant", light->getConstant());
-            shader->setFloat(base + ".linear", light->getLinear());
-            shader->setFloat(base + ".quadratic", light->getQuadratic());
-            shader->setFloat(base + ".intensity", light->getIntensity());
-
-        }
-
-        for (auto lightNode : spotLights) {
-            Light* light = lightNode->light;
-
-            std::string base = "spotLights[" + std::to_string(light->id) + "]";
-            shader->setBool(base + ".isOn", light->active);
-            shader->setVec3(base + ".position", lightNode->transform.getGlobalPosition());
-            shader->setVec3(base + ".ambient", light->getAmbient());
-            shader->setVec3(base + ".diffuse", light->getDiffuse());
-            shader->setVec3(base + ".specular", light->getSpecular());
-            shader->setFloat(base + ".constant", light->getConstant());
-            shader->setFloat(base + ".linear", light->getLinear());
-            shader->setFloat(base + ".quadratic", light->getQuadratic());
-            shader->setFloat(base + ".intensity", light->getIntensity());
-            shader->setFloat(base + ".linear", light->getLinear());
-            shader->setFloat(base + ".cutOff", light->getCutOff());
-            shader->setFloat(base + ".outerCutOff", light->getOuterCutOff());
-            shader->setVec3(base + ".direction", light->getDirection());
+// 4096 stones behind the houses, only rotated and uniformly scaled, so they can stream in the quaternion format
+InstanceManager* createStoneField() {
+    static Model stone("res/models/cube/cube.obj");
+    auto* stones = new InstanceManager(stone, InstanceManager::QUATERNION);
+    const int rows = 64;
+    for (int x = 0; x < rows; x++) {
+        for (int z = 0; z < rows; z++) {
+            const float angle = glm::radians(static_cast<float>((x * 37 + z * 59) % 360));
+            const float size = 0.3f + 0.1f * static_cast<float>((x * 7 + z * 3) % 5);
+            glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(x * 2.5f - 80.0f, size, z * 2.5f - 200.0f));
+            m = glm::rotate(m, angle, glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)));
+            stones->addMatrix(glm::scale(m, glm::vec3(size)));
         }
     }
+    stones->instantiate();
+    return stones;
+}
 
+// the reflective and refractive records picked by the last renderInstances()
+void renderPrefabEnvironment() {
+    for (PrefabInstancer* prefab : prefabs) {
+        prefab->draw(REFLECTIVE, prefabReflectiveShader, skybox->getCubemapTexture());
+        prefab->draw(REFRACTIVE, prefabRefractiveShader, skybox->getCubemapTexture());
+    }
 }
 
+
+
 void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightModel) {
 
     // Directional light
@@ -849,7 +883,7 @@ void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightM
     dirLightNode->transform.setLocalPosition(dirPos);
     dirLightNode->transform.setEulerRotation({45, -90, 0});
 
-    Light* dirLight = new Light(DIRECTIONAL, advancedShader, regularShader, 0);
+    Light* dirLight = new Light(DIRECTIONAL);
     // dirLight->setDirection({-0.2f, -1.0f, -0.3f});
     dirLight->setDirection(Util::getDirectionFromEulerAngles(dirLightNode->transform.getEulerRotation().x, dirLightNode->transform.getEulerRotation().y, dirLightNode->transform.getEulerRotation().z));
     dirLight->setAmbient({0.05f, 0.05f, 0.05f});
@@ -880,13 +914,12 @@ void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightM
     movingPointLight->transform.setLocalPosition(pos);
     movingPointLight->transform.setScale({2, 2, 2});
 
-    Light* mpl = new Light(POINT, advancedShader,regularShader, 0);
+    Light* mpl = new Light(POINT);
     mpl->setAmbient({0.55f, 0.55f, 0.55f});
     mpl->setDiffuse({0,0,1.0f});
     mpl->setSpecular({1.0f, 1.0f, 1.0f});
     mpl->setIntensity(10.0f);
-    mpl->setForTypeVec3("position", movingPointLight->transform.getGlobalPosition());
-    pointLights.push_back(movingPointLight.get());
+    mpl->setPosition(movingPointLight->transform.getGlobalPosition());
     movingPointLight->setLight(mpl);
 
     Node* lastEntity = root->find("Moving Light Handle");
@@ -901,7 +934,7 @@ void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightM
     spotLightNode->setStationary(true);
     flashlightNode = spotLightNode.get();
 
-    Light* spl = new Light(SPOTLIGHT, advancedShader,regularShader, 0);
+    Light* spl = new Light(SPOTLIGHT);
     spl->setAmbient({0,0,0});
     spl->setDiffuse({1.0f, 0, 0});
     spl->setIntensity(20.0f);
@@ -909,7 +942,6 @@ void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightM
     spl->setActive(false);
 
     spotLightNode->setLight(spl);
-    spotLights.push_back(spotLightNode.get());
 
     root->addChild(std::move(spotLightNode));
 
@@ -917,13 +949,13 @@ void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightM
     // Node* spotLightNode2 = new Node(&spotLightModel);
     spotLightNode2->setLabel("Spot Light 2");
     spotLightNode2->setStationary(true);
-    spotLightNode2->rotationSpeed = 0.0f;
+    spotLightNode2->setRotationSpeed(0.0f);
     glm::vec3 spotLightPos = spotLightNode2->transform.getLocalPosition();
     spotLightPos.y += 30;
     spotLightPos.x -= 10;
     spotLightNode2->transform.setLocalPosition(spotLightPos);
 
-    Light* spl2 = new Light(SPOTLIGHT, advancedShader,regularShader, 1);
+    Light* spl2 = new Light(SPOTLIGHT);
     spl2->setAmbient({0,0,0});
     spl2->setDiffuse({0.0f, 1.0f, 0});
     spl2->setDirection({0.0f, -1.0f, 0.0f});
@@ -933,98 +965,130 @@ void setUpLights(Model& pointLightModel, Model& spotLightModel, Model& dirLightM
     spotLightNode2->transform.setEulerRotation({90, 0, 0});
     spotLightNode2->setLight(spl2);
 
-    spotLights.push_back(spotLightNode2.get());
-
     root->addChild(std::move(spotLightNode2));
-
-    renderLights();
 }
 
 void setupShaders() {
     int width, height;
     glfwGetWindowSize(window, &width, &height);
-    float aspectRatio = static_cast<float>((float)width / (float)height);
-    glm::mat4 projection = camera.GetProjectionMatrix(aspectRatio);
-    glm::mat4 view = camera.GetViewMatrix();
-
-    testShader->use();
-    testShader->setMat4("projection", projection);
-
-    advancedShader->use();
-    advancedShader->setMat4("projection", projection);
-    advancedShader->setFloat("material.shininess", 32.0f);
+    aspectRatio = static_cast<float>((float)width / (float)height);
+    glfwGetFramebufferSize(window, &width, &height);
+    framebufferSize = glm::vec2(width, height);
+    deferredRenderer.resize(width, height);
+    // view and projection come from the frame uniform buffer, updated every frame
 
-    emissionShader->use();
-    emissionShader->setMat4("projection", projection);
+    for (Shader* shader : instanceShaders) {
+        shader->use();
+        shader->setFloat("material.shininess", 32.0f);
+    }
 
     regularShader->use();
-    regularShader->setMat4("projection", projection);
     regularShader->setFloat("material.shininess", 32.0f);
 
-    skyboxShader->use();
-    skyboxShader->setMat4("projection", projection);
+    prefabShader->use();
+    prefabShader->setFloat("material.shininess", 32.0f);
 
-    reflectiveShader->use();
-    reflectiveShader->setMat4("projection", projection);
-
-    refractiveShader->use();
-    refractiveShader->setVec3("iorRGB", ior);
-    refractiveShader->setFloat("aberrationStrength", chromaticAbberationStrength);
-    refractiveShader->setMat4("projection", projection);
+    for (Shader* shader : {refractiveShader, refractiveInstancedShader, prefabRefractiveShader}) {
+        shader->use();
+        shader->setVec3("iorRGB", ior);
+        shader->setFloat("aberrationStrength", chromaticAbberationStrength);
+    }
 
 }
 
-void renderEntityAndChildren(Node* entity) {
-
-    if (!entity || !entity->isVisible()) return;
+// Draws the entities whose bounds are inside the camera frustum, found through the scene BVH,
+// and not hidden behind the occluders. The occluders are rasterized while the BVH is walked.
+// Visible meshes go into the render queue, which sorts them by state before drawing.
+// With deferred shading the standard materials go into the G-buffer, everything else waits in the forward queue.
+// Nodes merged by the static batcher are skipped, their chunks are culled and queued as a whole instead.
+void renderEntities() {
+    const Frustum frustum = camera.GetFrustum(aspectRatio);
+    occlusionCuller.begin(camera.GetProjectionMatrix(aspectRatio) * camera.GetViewMatrix(), frustum, camera.Position, aspectRatio, threadPool);
+
+    visibleEntities.clear();
+    sceneBVH.query(frustum, visibleEntities);
+    occlusionCuller.finish(threadPool);
+
+    ComponentPool<Renderable>& renderables = EntityRegistry::get().pool<Renderable>();
+    renderQueue.clear();
+    forwardQueue.clear();
+    renderedTriangles = 0;
+    fullTriangles = 0;
+
+    // picks the program for a material, and whether it has to wait for the forward pass
+    auto shaderFor = [](Material material, bool emissive, bool& forward) {
+        Shader* shader = regularShader;
+        if (emissive) shader = emissionShader;
+        else if (material == REFLECTIVE) shader = reflectiveShader;
+        else if (material == REFRACTIVE) shader = refractiveShader;
+        forward = deferredShading && shader != regularShader;
+        if (deferredShading && !forward) shader = gbufferShader;
+        return shader;
+    };
 
-    if (entity->light) {
-        if (entity->model != nullptr) {
-            emissionShader->use();
-            emissionShader->setMat4("model", entity->transform.getModelMatrix());
-            emissionShader->setVec3("color", entity->light->diffuse);
+    for (Entity e : visibleEntities) {
+        if (staticBatcher.isBatched(e)) continue;
+        Node* entity = Node::findById(e);
+        if (!entity || !entity->isVisibleInHierarchy()) continue;
+        Renderable& renderable = renderables.get(e);
+
+        const glm::mat4& world = entity->transform.getModelMatrix();
+        if (!occlusionCuller.isVisible(renderable.model->bounds.transformed(world))) continue;
+        const float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        const glm::vec3 center = glm::vec3(world * glm::vec4(renderable.model->sphere.center, 1.0f));
+        const float distance = LodSettings::sphereDistance(camera.Position, center, renderable.model->sphere.radius * scale);
+        renderable.lod = static_cast<uint8_t>(lodSettings.select(*renderable.model, scale, distance, renderable.lod));
+        renderedTriangles += renderable.model->getTriangleCount(renderable.lod);
+        fullTriangles += renderable.model->getTriangleCount(0);
+
+        // one packet per mesh, state changes are left to the queue
+        Light* light = entity->getLight();
+        bool forward;
+        Shader* shader = shaderFor(renderable.material, light != nullptr, forward);
+        RenderQueue& queue = forward ? forwardQueue : renderQueue;
+
+        const float depth = glm::dot(center - camera.Position, camera.Front) / camera.FarPlane;
+        for (const Mesh& mesh : renderable.model->meshes) {
+            DrawPacket packet;
+            packet.key = queue.makeKey(RenderQueue::OPAQUE_PASS, shader, renderable.material, mesh, depth);
+            packet.shader = shader;
+            packet.mesh = &mesh;
+            packet.model = &world;
+            packet.color = light ? light->diffuse : glm::vec3(0.0f);
+            packet.lod = renderable.lod;
+            packet.emissive = light != nullptr;
+            queue.push(packet);
         }
-        entity->Draw(emissionShader, skybox->getCubemapTexture());
     }
-    else if (entity->model != nullptr) {
-        switch (entity->material) {
-            case STANDARD:
-                regularShader->use();
-                regularShader->setMat4("model", entity->transform.getModelMatrix());
-
-                entity->Draw(regularShader, skybox->getCubemapTexture());
-                break;
-            case REFLECTIVE:
-                reflectiveShader->use();
-                reflectiveShader->setMat4("model", entity->transform.getModelMatrix());
-                reflectiveShader->setVec3("cameraPos", camera.Position);
-
-                entity->Draw(reflectiveShader, skybox->getCubemapTexture());
-                break;
-            case REFRACTIVE:
-
-                refractiveShader->use();
-                refractiveShader->setMat4("model", entity->transform.getModelMatrix());
-                refractiveShader->setVec3("cameraPos", camera.Position);
-                // refractiveShader->setSampler2D("screenTexture", colorTexture);
-
-
-                entity->Draw(refractiveShader, skybox->getCubemapTexture());
-                break;
-            default:
-                regularShader->use();
-                regularShader->setMat4("model", entity->transform.getModelMatrix());
-
-                entity->Draw(regularShader, skybox->getCubemapTexture());
-                break;
-        }
 
+    if (staticBatcher.enabled) {
+        for (const StaticBatcher::Chunk& chunk : staticBatcher.getChunks()) {
+            if (!chunk.bounds.isValid() || !frustum.intersects(chunk.bounds) || !occlusionCuller.isVisible(chunk.bounds)) continue;
+            const float depth = glm::dot(chunk.bounds.getCenter() - camera.Position, camera.Front) / camera.FarPlane;
+            for (const StaticBatcher::Batch& batch : chunk.batches) {
+                if (batch.mesh->indices.empty()) continue;
+                bool forward;
+                Shader* shader = shaderFor(batch.material, false, forward);
+                RenderQueue& queue = forward ? forwardQueue : renderQueue;
+                DrawPacket packet;
+                packet.key = queue.makeKey(RenderQueue::OPAQUE_PASS, shader, batch.material, *batch.mesh, depth);
+                packet.shader = shader;
+                packet.mesh = batch.mesh.get();
+                packet.model = &StaticBatcher::IDENTITY;
+                packet.color = glm::vec3(0.0f);
+                packet.lod = 0;
+                packet.emissive = false;
+                queue.push(packet);
+                renderedTriangles += batch.mesh->indices.size() / 3;
+                fullTriangles += batch.mesh->indices.size() / 3;
+            }
+        }
     }
 
-    // Render children
-    for (auto& child : entity->children) {
-        renderEntityAndChildren(child.get());
-    }
+    GLStateCache::get().polygonMode(wireframe ? GL_LINE : GL_FILL);
+    renderQueue.sort();
+    renderQueue.execute(skybox->getCubemapTexture());
+    forwardQueue.sort();
 }
 
 void imgui_begin()
@@ -1043,12 +1107,12 @@ void drawSceneTree(Node* node) {
     if (!node) return;
 
     if (ImGui::TreeNode(node, "%s : Node", node->getLabel())) {
-        if (node->model && node->light == nullptr) {
+        if (node->getModel() && node->getLight() == nullptr) {
             ImGui::Text("Material");
             ImGui::SameLine();
 
-            const std::vector<std::string> items = node->materialMap;
-            static int selected_material_idx = node->material;
+            const std::vector<std::string>& items = Node::materialMap;
+            static int selected_material_idx = node->getMaterial();
 
             const std::string comboPreviewValue = items[selected_material_idx];
             if (ImGui::BeginCombo("##", comboPreviewValue.c_str())) {
@@ -1057,6 +1121,7 @@ void drawSceneTree(Node* node) {
                     if (ImGui::Selectable(items[i].c_str(), is_selected)) {
                         selected_material_idx = i;
                         node->setMaterial((Material) selected_material_idx);
+                        staticBatcher.invalidate(node->getId());
                     }
 
                     if (is_selected) {
@@ -1066,6 +1131,18 @@ void drawSceneTree(Node* node) {
                 ImGui::EndCombo();
             }
         }
+        if (PrefabComponent* prefab = node->getPrefabInstance()) {
+            PrefabInstancer::Record& record = prefab->instancer->getRecord(prefab->record);
+            ImGui::ColorEdit4("Tint", (float*) &record.tint);
+            const char* materials[PrefabInstancer::MATERIAL_COUNT];
+            for (int i = 0; i < PrefabInstancer::MATERIAL_COUNT; i++) materials[i] = Node::materialMap[i].c_str();
+            int material = record.material;
+            if (ImGui::Combo("Prefab material", &material, materials, PrefabInstancer::MATERIAL_COUNT))
+                record.material = (Material) material;
+            int lod = record.lod;
+            if (ImGui::SliderInt("Level (-1 auto)", &lod, PrefabInstancer::AUTO_LOD, Mesh::MAX_LODS - 1))
+                record.lod = static_cast<int8_t>(lod);
+        }
         if(ImGui::TreeNode("Transform")) {
             std::string pos = "x: " + Util::format(node->transform.getLocalPosition().x, 2) + ", y: " + Util::format(node->transform.getLocalPosition().y, 2) + ", z: " + Util::format(node->transform.getLocalPosition().z, 2);
             ImGui::Text(("Position: " + pos).c_str());
@@ -1080,15 +1157,15 @@ void drawSceneTree(Node* node) {
             ImGui::DragFloat3("##localRot",(float*) &rotationVec, 1.0f);
             if (node->transform.getEulerRotation() != rotationVec) {
                 node->transform.setEulerRotation(rotationVec);
-                if (node->light)
-                    node->light->setDirection(Util::getDirectionFromEulerAngles(rotationVec.x, rotationVec.y, rotationVec.z));
+                if (node->getLight())
+                    node->getLight()->setDirection(Util::getDirectionFromEulerAngles(rotationVec.x, rotationVec.y, rotationVec.z));
             }
 
-            std::string scl = "x: " + Util::format(node->transform.scale.x, 2) + ", y: " + Util::format(node->transform.scale.y, 2) + ", z: " + Util::format(node->transform.scale.z, 2);
+            std::string scl = "x: " + Util::format(node->transform.getScale().x, 2) + ", y: " + Util::format(node->transform.getScale().y, 2) + ", z: " + Util::format(node->transform.getScale().z, 2);
             ImGui::Text(("Scale: " + scl).c_str());
-            glm::vec3 sclVec = node->transform.scale;
+            glm::vec3 sclVec = node->transform.getScale();
             ImGui::DragFloat3("##localScale",(float*) &sclVec, 0.1f);
-            if (node->transform.scale != sclVec) {
+            if (node->transform.getScale() != sclVec) {
                 node->transform.setScale(sclVec);
             }
 
@@ -1096,7 +1173,7 @@ void drawSceneTree(Node* node) {
                 std::vector<glm::vec3> transforms = {
                     node->transform.getLocalPosition(),
                     node->transform.getEulerRotation(),
-                    node->transform.scale
+                    node->transform.getScale()
                 };
                 animator->RecordKeyFrame("robot/" + static_cast<std::string>(node->getLabel()), transforms, timeForFrame);
             }
@@ -1107,36 +1184,36 @@ void drawSceneTree(Node* node) {
         }
 
 
-        if (node->light) {
+        if (Light* light = node->getLight()) {
             ImGui::Text("State:");
             ImGui::SameLine();
-            if (ImGui::Button(node->light->active ? "On" : "Off")) {
-                node->light->setActive(!node->light->active);
+            if (ImGui::Button(light->active ? "On" : "Off")) {
+                light->setActive(!light->active);
             }
 
             ImGui::Text("Color:");
             ImGui::SameLine();
-            glm::vec3 color = node->light->diffuse;
+            glm::vec3 color = light->diffuse;
             ImGui::ColorEdit3("##color", (float*) &color);
-            if (color != node->light->diffuse) {
-                node->light->setDiffuse(color);
+            if (color != light->diffuse) {
+                light->setDiffuse(color);
             }
 
             ImGui::Text("Intensity:");
             ImGui::SameLine();
-            float intensity =  node->light->getIntensity();
+            float intensity =  light->getIntensity();
             ImGui::DragFloat("##intensity", &intensity, 0.1f, 0.0f, 500.0f);
-            if (intensity != node->light->getIntensity()) {
-                node->light->setIntensity(intensity);
+            if (intensity != light->getIntensity()) {
+                light->setIntensity(intensity);
             }
 
-            if (node->light->type == SPOTLIGHT || node->light->type == DIRECTIONAL) {
+            if (light->type == SPOTLIGHT || light->type == DIRECTIONAL) {
                 ImGui::Text("Direction:");
                 ImGui::SameLine();
-                glm::vec3 dir = node->light->getDirection();
+                glm::vec3 dir = light->getDirection();
                 ImGui::DragFloat3("##direction", (float*) &dir, 0.01f, -1, 1);
-                if (dir != node->light->getDirection()) {
-                    node->light->setDirection(dir);
+                if (dir != light->getDirection()) {
+                    light->setDirection(dir);
                 }
 
 
@@ -1169,6 +1246,71 @@ void imgui_render()
         if (ImGui::BeginTabBar("Tabs")) {
             if (ImGui::BeginTabItem("Scene")) {
                 ImGui::Checkbox("Wireframe", &wireframe);
+                ImGui::Checkbox("Deferred shading", &deferredShading);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("The G-buffer keeps only the red channel of specular maps,\n"
+                                      "coloured specular shows up grey compared to forward shading.");
+                }
+                if (deferredShading) {
+                    ImGui::Text("GPU ms, geometry: %.3f, lighting: %.3f, forward: %.3f", geometryTimer.milliseconds,
+                                lightingTimer.milliseconds, forwardTimer.milliseconds);
+                } else {
+                    ImGui::Text("GPU ms, opaque: %.3f, skybox: %.3f", geometryTimer.milliseconds, forwardTimer.milliseconds);
+                }
+                ImGui::Text("Visible: %zu / %zu (BVH nodes visited: %zu)", visibleEntities.size(), sceneBVH.size(), sceneBVH.nodesVisited);
+                if (ImGui::Checkbox("Stone field (quaternion instances)", &stoneFieldEnabled)) {
+                    if (!stoneField) stoneField = createStoneField();
+                    if (stoneFieldEnabled) instances.push_back(stoneField);
+                    else instances.erase(std::remove(instances.begin(), instances.end(), stoneField), instances.end());
+                }
+                for (size_t i = 0; i < instances.size(); i++) {
+                    ImGui::PushID(static_cast<int>(i));
+                    ImGui::Checkbox("Cull instances", &instances[i]->cullingEnabled);
+                    ImGui::SameLine();
+                    ImGui::Text("%zu / %zu", instances[i]->visibleCount, instances[i]->modelMatrices.size());
+                    const char* formats[] = {"Matrix (64 B)", "Affine 3x4 (48 B)", "Quaternion (24 B)"};
+                    int format = instances[i]->getFormat();
+                    if (ImGui::Combo("Instance format", &format, formats, InstanceManager::FORMAT_COUNT))
+                        instances[i]->setFormat((InstanceManager::Format) format);
+                    const size_t* lods = instances[i]->lodCounts;
+                    ImGui::Text("LOD instances: %zu / %zu / %zu / %zu", lods[0], lods[1], lods[2], lods[3]);
+                    ImGui::PopID();
+                }
+                for (size_t i = 0; i < prefabs.size(); i++) {
+                    ImGui::PushID(static_cast<int>(instances.size() + i));
+                    ImGui::Checkbox("Cull prefabs", &prefabs[i]->cullingEnabled);
+                    ImGui::SameLine();
+                    ImGui::Text("%zu / %zu in %zu draws", prefabs[i]->visibleCount, prefabs[i]->size(), prefabs[i]->drawCount);
+                    ImGui::PopID();
+                }
+                ImGui::Checkbox("LOD", &lodSettings.enabled);
+                ImGui::SliderFloat("LOD pixel error", &lodSettings.maxPixelError, 0.25f, 16.0f);
+                ImGui::SliderFloat("LOD hysteresis", &lodSettings.hysteresis, 0.0f, 0.9f);
+                ImGui::Text("Triangles: %zu / %zu", renderedTriangles, fullTriangles);
+                ImGui::Text("Draws: %zu, program / texture / VAO changes: %zu / %zu / %zu", renderQueue.drawCount,
+                            renderQueue.programChanges, renderQueue.textureChanges, renderQueue.vertexArrayChanges);
+                if (deferredShading) ImGui::Text("Forward draws after lighting: %zu", forwardQueue.drawCount);
+                ImGui::Checkbox("Automatic instancing", &renderQueue.instancing);
+                forwardQueue.instancing = renderQueue.instancing;
+                ImGui::Text("Instanced draws: %zu, covering %zu meshes", renderQueue.instancedDraws + forwardQueue.instancedDraws,
+                            renderQueue.instancedPackets + forwardQueue.instancedPackets);
+                ImGui::Text("Geometry pool: %zu blocks, %.1f / %.1f MB", GeometryPool::get().blockCount(),
+                            GeometryPool::get().usedBytes / 1048576.0f, GeometryPool::get().reservedBytes / 1048576.0f);
+                ImGui::Text("Unchanged uniforms skipped: %zu", Shader::skippedUniforms);
+                ImGui::Text("GL state changes issued: %zu, filtered: %zu", GLStateCache::get().issuedCount,
+                            GLStateCache::get().filteredCount);
+                ImGui::Text("Lights: %zu, uploaded %zu bytes", LightManager::get().size(), LightManager::get().uploadedBytes);
+                ImGui::Text("Streamed %zu bytes, waited for the GPU %zu times, %zu reallocations", StreamingBuffer::streamedBytes,
+                            StreamingBuffer::waitCount, StreamingBuffer::growCount);
+                ImGui::Text("Clustered lights: %zu in view, %zu list entries, at most %zu per cluster", lightClusters.lightCount,
+                            lightClusters.indexCount, lightClusters.maxLightsPerCluster);
+                ImGui::Checkbox("Static batching", &staticBatcher.enabled);
+                ImGui::Text("Batched nodes: %zu in %zu chunks (%zu triangles), animated: %zu, chunk rebuilds: %zu",
+                            staticBatcher.batchedCount(), staticBatcher.getChunks().size(), staticBatcher.batchedTriangles,
+                            staticBatcher.ejectedCount(), staticBatcher.rebuiltChunks);
+                ImGui::Checkbox("Occlusion culling", &occlusionCuller.enabled);
+                ImGui::Text("Occluders: %zu (%zu triangles), occluded: %zu / %zu", occlusionCuller.occluderCount,
+                            occlusionCuller.buffer.rasterizedTriangles, occlusionCuller.occludedCount, occlusionCuller.testedCount);
                 drawSceneTree(root);
                 ImGui::EndTabItem();
             }
@@ -1211,12 +1353,16 @@ void imgui_render()
             if (ImGui::BeginTabItem("Shaders")) {
                 ImGui::Text("Refractive Shader Parameters:");
                 if (ImGui::DragFloat3("IOR", (float*) &ior, 0.01f)) {
-                    refractiveShader->use();
-                    refractiveShader->setVec3("iorRGB", ior);
+                    for (Shader* shader : {refractiveShader, refractiveInstancedShader, prefabRefractiveShader}) {
+                        shader->use();
+                        shader->setVec3("iorRGB", ior);
+                    }
                 }
                 if (ImGui::DragFloat("Chromatic Abberation Strength", &chromaticAbberationStrength, 0.01f)) {
-                    refractiveShader->use();
-                    refractiveShader->setFloat("aberrationStrength", chromaticAbberationStrength);
+                    for (Shader* shader : {refractiveShader, refractiveInstancedShader, prefabRefractiveShader}) {
+                        shader->use();
+                        shader->setFloat("aberrationStrength", chromaticAbberationStrength);
+                    }
                 }
 
                 ImGui::EndTabItem();
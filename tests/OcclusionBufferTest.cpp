@@ -0,0 +1,60 @@
+//
+// Created by Hubert Klonowski on 17/10/2026.
+//
+
+#include <glad/glad.h>
+#include <cstdio>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionBuffer.h"
+
+// Camera at the origin looking down -z, a 10 x 10 wall 10 units in front of it.
+static int failures = 0;
+
+static void check(bool condition, const char* name) {
+    std::printf("%s: %s\n", condition ? "ok  " : "FAIL", name);
+    if (!condition) failures++;
+}
+
+static AABB box(const glm::vec3& min, const glm::vec3& max) {
+    AABB b;
+    b.min = min;
+    b.max = max;
+    return b;
+}
+
+// z = 0 quad spanning [-halfSize, halfSize] on x and y
+static std::vector<Vertex> quad(float halfSize) {
+    std::vector<Vertex> vertices(4);
+    vertices[0].position = {-halfSize, -halfSize, 0};
+    vertices[1].position = {halfSize, -halfSize, 0};
+    vertices[2].position = {halfSize, halfSize, 0};
+    vertices[3].position = {-halfSize, halfSize, 0};
+    return vertices;
+}
+
+int main() {
+    const unsigned int indices[6] = {0, 1, 2, 0, 2, 3};
+    const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.6f, 0.1f, 400.0f)
+                                   * glm::lookAt(glm::vec3(0.0f), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+
+    OcclusionBuffer buffer;
+    buffer.resize(OcclusionBuffer::DEFAULT_WIDTH, 200);
+    buffer.clear(viewProjection);
+    check(buffer.isVisible(box({-1, -1, -20}, {1, 1, -19})), "empty buffer hides nothing");
+
+    buffer.rasterize(glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, -10)), quad(5.0f), indices, 6);
+    check(buffer.rasterizedTriangles == 2, "both wall triangles rasterized");
+
+    // a smaller quad behind the wall, flat boxes are what a quad's bounds look like
+    check(!buffer.isVisible(box({-2, -2, -20}, {2, 2, -20})), "quad behind the wall is hidden");
+    check(!buffer.isVisible(box({-1, -1, -30}, {1, 1, -28})), "box behind the wall is hidden");
+    check(buffer.isVisible(box({-1, -1, -6}, {1, 1, -4})), "box in front of the wall is visible");
+    check(buffer.isVisible(box({14, -1, -21}, {16, 1, -19})), "box beside the wall is visible");
+    check(buffer.isVisible(box({-1, 4, -13}, {1, 7, -11})), "box poking out over the wall is visible");
+    check(buffer.isVisible(box({-1, -1, -1}, {1, 1, 1})), "box around the camera is visible");
+
+    std::printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}